@@ -0,0 +1,264 @@
+// Echo load generator, e.g., for |echo_server_async|.
+// N connections each send a message of the given size and read it back, one
+// echo at a time, for the given duration. Reported are the messages (echoes)
+// per second, the echo latency percentiles and the CPU usage.
+// With --threads=1 (the default), the io_context is constructed with
+// BOOST_ASIO_CONCURRENCY_HINT_UNSAFE, i.e., without the locking of the
+// scheduler and the reactor, since only one thread ever uses it; --safe keeps
+// the default hint, for comparison. With more threads, they all run the same
+// io_context.
+// With --spin-us=<us>, the threads busy-poll the io_context for that long
+// before blocking (see utility::RunBusyPolling()), and with
+// --busy-poll-us=<us>, the kernel busy-polls the device queue of the sockets
+// (SO_BUSY_POLL). Compare the latencies to the CPU usage.
+// E.g.,
+//   $ echo_server_async 2017
+//   $ echo_load localhost 2017 --connections=10 --duration=10
+//   $ echo_load localhost 2017 --connections=10 --duration=10 --safe
+//   $ echo_load localhost 2017 --connections=1 --spin-us=50
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio.hpp"
+
+#include "low_latency_runner.h"
+#include "utility.h"
+
+using boost::asio::ip::tcp;
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+// Per connection, so that the threads don't share them.
+struct Stats {
+  std::size_t echoes = 0;
+  std::size_t errors = 0;
+  std::vector<double> echo_latencies;  // Microseconds
+};
+
+class Connection {
+public:
+  Connection(boost::asio::io_context& io_context,
+             const tcp::resolver::results_type& endpoints,
+             std::size_t message_size, int busy_poll_us)
+      : socket_(io_context), endpoints_(endpoints),
+        request_(message_size, 'x'), reply_(message_size),
+        busy_poll_us_(busy_poll_us) {
+  }
+
+  void Start() {
+    boost::asio::async_connect(socket_, endpoints_,
+                               std::bind(&Connection::HandleConnect, this,
+                                         std::placeholders::_1));
+  }
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  void HandleConnect(boost::system::error_code ec) {
+    if (ec) {
+      ++stats_.errors;
+      return;
+    }
+
+    socket_.set_option(tcp::no_delay(true), ec);
+    if (ec) {
+      ++stats_.errors;
+      return;
+    }
+    if (busy_poll_us_ > 0 &&
+        !utility::SetBusyPoll(socket_.native_handle(), busy_poll_us_)) {
+      std::cerr << "Failed to set SO_BUSY_POLL." << std::endl;
+    }
+
+    DoEcho();
+  }
+
+  void DoEcho() {
+    echo_time_ = Clock::now();
+
+    boost::asio::async_write(socket_, boost::asio::buffer(request_),
+                             std::bind(&Connection::HandleWrite, this,
+                                       std::placeholders::_1));
+  }
+
+  void HandleWrite(boost::system::error_code ec) {
+    if (ec) {
+      ++stats_.errors;
+      return;
+    }
+
+    boost::asio::async_read(socket_, boost::asio::buffer(reply_),
+                            std::bind(&Connection::HandleRead, this,
+                                      std::placeholders::_1));
+  }
+
+  void HandleRead(boost::system::error_code ec) {
+    if (ec) {
+      ++stats_.errors;
+      return;
+    }
+
+    std::chrono::duration<double, std::micro> latency =
+        Clock::now() - echo_time_;
+    stats_.echo_latencies.push_back(latency.count());
+    ++stats_.echoes;
+
+    DoEcho();
+  }
+
+  tcp::socket socket_;
+  tcp::resolver::results_type endpoints_;
+
+  std::vector<char> request_;
+  std::vector<char> reply_;
+
+  int busy_poll_us_;
+
+  Clock::time_point echo_time_;
+
+  Stats stats_;
+};
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <host> <port> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --connections=<n>  Default: 10" << std::endl;
+  std::cout << "    --message=<n>      Bytes per echo. Default: 64"
+            << std::endl;
+  std::cout << "    --duration=<n>     Seconds. Default: 10" << std::endl;
+  std::cout << "    --threads=<n>      Threads running the loop. Default: 1"
+            << std::endl;
+  std::cout << "    --safe             Keep the default concurrency hint with"
+            << " one thread." << std::endl;
+  std::cout << "    --spin-us=<us>     Busy-poll the loop before blocking."
+            << std::endl;
+  std::cout << "    --busy-poll-us=<us>  SO_BUSY_POLL on the sockets."
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::string host = options.args()[0];
+  std::string port = options.args()[1];
+
+  std::size_t connection_count = options.GetInt("connections", 10);
+  std::size_t message_size = options.GetInt("message", 64);
+  double duration = options.GetDouble("duration", 10.0);
+  std::size_t threads = options.GetInt("threads", 1);
+  bool safe = options.Has("safe");
+  std::chrono::microseconds spin(options.GetInt("spin-us", 0));
+  int busy_poll_us = static_cast<int>(options.GetInt("busy-poll-us", 0));
+
+  if (connection_count == 0 || message_size == 0 || duration <= 0 ||
+      threads == 0) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  // Only safe if no other thread touches the io_context, its sockets or its
+  // timers at all; note that async_resolve() isn't supported then.
+  int concurrency_hint = BOOST_ASIO_CONCURRENCY_HINT_DEFAULT;
+  if (threads > 1) {
+    concurrency_hint = static_cast<int>(threads);
+  } else if (!safe) {
+    concurrency_hint = BOOST_ASIO_CONCURRENCY_HINT_UNSAFE;
+  }
+
+  try {
+    boost::asio::io_context io_context(concurrency_hint);
+
+    tcp::resolver resolver(io_context);
+    auto endpoints = resolver.resolve(tcp::v4(), host, port);
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (std::size_t i = 0; i < connection_count; ++i) {
+      connections.emplace_back(new Connection(io_context, endpoints,
+                                              message_size, busy_poll_us));
+      connections.back()->Start();
+    }
+
+    // Stop everything when the time is up; the pending operations are just
+    // abandoned.
+    boost::asio::steady_timer stop_timer(io_context);
+    stop_timer.expires_after(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(duration)));
+    stop_timer.async_wait([&io_context](boost::system::error_code) {
+      io_context.stop();
+    });
+
+    double cpu_seconds = utility::GetCpuSeconds();
+    Clock::time_point start = Clock::now();
+
+    auto run = [&io_context, spin]() {
+      if (spin.count() > 0) {
+        utility::RunBusyPolling(io_context, spin);
+      } else {
+        io_context.run();
+      }
+    };
+
+    std::vector<std::thread> loops;
+    for (std::size_t i = 1; i < threads; ++i) {
+      loops.emplace_back(run);
+    }
+    run();
+    for (std::thread& loop : loops) {
+      loop.join();
+    }
+
+    std::chrono::duration<double> seconds = Clock::now() - start;
+    cpu_seconds = utility::GetCpuSeconds() - cpu_seconds;
+
+    Stats stats;
+    for (const std::unique_ptr<Connection>& connection : connections) {
+      const Stats& s = connection->stats();
+      stats.echoes += s.echoes;
+      stats.errors += s.errors;
+      stats.echo_latencies.insert(stats.echo_latencies.end(),
+                                  s.echo_latencies.begin(),
+                                  s.echo_latencies.end());
+    }
+    std::sort(stats.echo_latencies.begin(), stats.echo_latencies.end());
+
+    std::cout << "connections: " << connection_count
+              << ", message: " << message_size << " bytes"
+              << ", threads: " << threads
+              << (threads == 1 && !safe ? " (unsafe hint)" : "")
+              << ", spin: " << spin.count() << " us"
+              << ", busy poll: " << busy_poll_us << " us" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "messages/s: " << stats.echoes / seconds.count()
+              << ", errors: " << stats.errors
+              << ", CPU: " << cpu_seconds / seconds.count() * 100 << "%"
+              << std::endl;
+    std::cout << "echo latency: p50 "
+              << utility::Percentile(stats.echo_latencies, 0.5)
+              << ", p99 " << utility::Percentile(stats.echo_latencies, 0.99)
+              << " us" << std::endl;
+
+  } catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,14 +1,47 @@
 // Asynchronous echo server.
+// The io_context of the main thread is only ever used by that thread, so it's
+// constructed with BOOST_ASIO_CONCURRENCY_HINT_UNSAFE, i.e., the scheduler and
+// the reactor don't lock; --safe keeps the default hint, for comparison (see
+// |echo_load| for the messages/s).
+// With --threads=<n> (n > 1), the sessions are spread over a
+// utility::IoContextPool of n io_contexts, round-robin or, with
+// --least-loaded, to the io_context with the fewest live sessions. The
+// acceptor stays on the io_context of the main thread. The sessions are
+// created on the threads of their io_contexts.
+// With --cpus=<list>, the threads (of the pool) are pinned to the CPUs, one
+// each (in turn if there are fewer CPUs than threads), and with
+// --incoming-cpu, a session goes to the thread pinned to the CPU which
+// processes the packets of its socket (SO_INCOMING_CPU), if any. Linux only.
+// With --spin-us=<us>, the threads busy-poll their io_contexts for that long
+// before blocking (see utility::RunBusyPolling()), and with
+// --busy-poll-us=<us>, the kernel busy-polls the device queue of the sockets
+// (SO_BUSY_POLL).
+// E.g.,
+//   $ echo_server_async 2017
+//   $ echo_server_async 2017 --safe
+//   $ echo_server_async 2017 --threads=4 --least-loaded
+//   $ echo_server_async 2017 --threads=4 --cpus=0-3 --incoming-cpu
+//   $ echo_server_async 2017 --spin-us=50 --busy-poll-us=50
 
 #include <array>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif  // !defined(_WIN32)
 
 #include "boost/asio.hpp"
 #include "boost/core/ignore_unused.hpp"
 
+#include "io_context_pool.h"
+#include "low_latency_runner.h"
+#include "utility.h"
+
 using boost::asio::ip::tcp;
 
 // -----------------------------------------------------------------------------
@@ -21,7 +54,16 @@ enum { BUF_SIZE = 1024 };
 
 class Session : public std::enable_shared_from_this<Session> {
  public:
-  Session(tcp::socket socket) : socket_(std::move(socket)) {
+  // |pool| is the pool of the socket's io_context |index|, if any.
+  Session(tcp::socket socket, utility::IoContextPool* pool = nullptr,
+          std::size_t index = 0)
+      : socket_(std::move(socket)), pool_(pool), index_(index) {
+  }
+
+  ~Session() {
+    if (pool_ != nullptr) {
+      pool_->Release(index_);
+    }
   }
 
   void Start() {
@@ -97,46 +139,208 @@ class Session : public std::enable_shared_from_this<Session> {
 
   tcp::socket socket_;
   std::array<char, BUF_SIZE> buffer_;
+
+  utility::IoContextPool* pool_;
+  std::size_t index_;
 };
 
 // -----------------------------------------------------------------------------
 
 class Server {
  public:
-  Server(boost::asio::io_context& io_context, std::uint16_t port)
-      : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)) {
+  // The sessions go to |pool| if not null, otherwise they stay on the
+  // io_context of the acceptor. With |incoming_cpu|, to the io_context pinned
+  // to the CPU of the socket, if any. With |busy_poll_us| > 0, SO_BUSY_POLL
+  // is set on the accepted sockets.
+  Server(boost::asio::io_context& io_context, std::uint16_t port,
+         utility::IoContextPool* pool = nullptr, bool incoming_cpu = false,
+         int busy_poll_us = 0)
+      : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), pool_(pool),
+        incoming_cpu_(incoming_cpu), busy_poll_us_(busy_poll_us) {
     DoAccept();
   }
 
  private:
   void DoAccept() {
+    if (pool_ != nullptr) {
+      if (incoming_cpu_) {
+        DoAcceptByCpu();
+      } else {
+        DoAcceptToPool();
+      }
+      return;
+    }
+
     acceptor_.async_accept(
         [this](boost::system::error_code ec, tcp::socket socket) {
           if (!ec) {
+            SetBusyPoll(socket);
             std::make_shared<Session>(std::move(socket))->Start();
           }
           DoAccept();
         });
   }
 
+  void DoAcceptToPool() {
+    // The peer socket is created on the picked io_context.
+    std::size_t index = pool_->Acquire();
+
+    acceptor_.async_accept(
+        pool_->Get(index),
+        [this, index](boost::system::error_code ec, tcp::socket socket) {
+          if (!ec) {
+            PostSession(std::move(socket), index);
+          } else {
+            pool_->Release(index);
+          }
+          DoAccept();
+        });
+  }
+
+  void DoAcceptByCpu() {
+    // The CPU of the socket is only known once accepted, so the socket is
+    // moved to the picked io_context afterwards.
+    acceptor_.async_accept(
+        [this](boost::system::error_code ec, tcp::socket socket) {
+          if (!ec) {
+            MoveToPool(std::move(socket));
+          }
+          DoAccept();
+        });
+  }
+
+  // Re-create |socket| on the io_context of the CPU processing its packets
+  // and start the session there. On any error the connection is closed.
+  void MoveToPool(tcp::socket socket) {
+    boost::system::error_code ec;
+    tcp::endpoint local = socket.local_endpoint(ec);
+    if (ec) {
+      return;
+    }
+
+    int cpu = utility::GetIncomingCpu(socket.native_handle());
+    std::size_t index = pool_->Acquire(cpu);
+
+    tcp::socket::native_handle_type handle = socket.release(ec);
+    if (ec) {
+      pool_->Release(index);
+      return;
+    }
+
+    tcp::socket moved(pool_->Get(index));
+    moved.assign(local.protocol(), handle, ec);
+    if (ec) {
+      // Nobody owns the handle any more.
+#if defined(_WIN32)
+      ::closesocket(handle);
+#else
+      ::close(handle);
+#endif  // defined(_WIN32)
+      pool_->Release(index);
+      return;
+    }
+
+    PostSession(std::move(moved), index);
+  }
+
+  // Create and start the session on the thread of io_context |index|, so that
+  // its memory is first touched there (i.e., comes from its NUMA node).
+  void PostSession(tcp::socket socket, std::size_t index) {
+    boost::asio::post(pool_->Get(index),
+                      std::bind(&Server::StartSession, this,
+                                std::move(socket), index));
+  }
+
+  void StartSession(tcp::socket& socket, std::size_t index) {
+    SetBusyPoll(socket);
+    std::make_shared<Session>(std::move(socket), pool_, index)->Start();
+  }
+
+  void SetBusyPoll(tcp::socket& socket) {
+    if (busy_poll_us_ > 0 &&
+        !utility::SetBusyPoll(socket.native_handle(), busy_poll_us_)) {
+      std::cerr << "Failed to set SO_BUSY_POLL." << std::endl;
+    }
+  }
+
   tcp::acceptor acceptor_;
+  utility::IoContextPool* pool_;
+  bool incoming_cpu_;
+  int busy_poll_us_;
 };
 
 // -----------------------------------------------------------------------------
 
+void Help(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " <port> [options]" << std::endl;
+  std::cerr << "  Options:" << std::endl;
+  std::cerr << "    --threads=<n>    Sessions on a pool of n io_contexts if"
+            << " n > 1. Default: 1" << std::endl;
+  std::cerr << "    --least-loaded   To the io_context of fewest sessions."
+            << std::endl;
+  std::cerr << "    --cpus=<list>    Pin the threads to the CPUs, e.g., 0-3."
+            << std::endl;
+  std::cerr << "    --incoming-cpu   To the thread pinned to the socket's CPU."
+            << std::endl;
+  std::cerr << "    --safe           Keep the default concurrency hint."
+            << std::endl;
+  std::cerr << "    --spin-us=<us>   Busy-poll the loop before blocking."
+            << std::endl;
+  std::cerr << "    --busy-poll-us=<us>  SO_BUSY_POLL on the sockets."
+            << std::endl;
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 1) {
+    Help(argv[0]);
     return 1;
   }
 
-  std::uint16_t port = std::atoi(argv[1]);
+  std::uint16_t port = std::atoi(options.args()[0].c_str());
+  std::size_t threads = options.GetInt("threads", 1);
+  std::vector<int> cpus = utility::ParseCpuList(options.Get("cpus"));
+  std::chrono::microseconds spin(options.GetInt("spin-us", 0));
+
+  if (threads == 0) {
+    Help(argv[0]);
+    return 1;
+  }
 
-  boost::asio::io_context io_context;
+  // Even with a pool, no other thread touches this io_context or the acceptor:
+  // the pool threads have their own io_contexts. Note that async_resolve()
+  // isn't supported with the unsafe hint.
+  boost::asio::io_context io_context(
+      options.Has("safe") ? BOOST_ASIO_CONCURRENCY_HINT_DEFAULT
+                          : BOOST_ASIO_CONCURRENCY_HINT_UNSAFE);
 
-  Server server{ io_context, port };
+  std::unique_ptr<utility::IoContextPool> pool;
+  if (threads > 1) {
+    pool.reset(new utility::IoContextPool(
+        threads, options.Has("least-loaded")
+                     ? utility::IoContextPool::kLeastLoaded
+                     : utility::IoContextPool::kRoundRobin));
 
-  io_context.run();
+    for (std::size_t i = 0; i < threads && !cpus.empty(); ++i) {
+      pool->SetCpus(i, { cpus[i % cpus.size()] });
+    }
+
+    pool->SetBusyPoll(spin);
+    pool->Start();
+  } else if (!cpus.empty() && !utility::SetThreadAffinity({ cpus[0] })) {
+    std::cerr << "Failed to pin the thread to the CPU." << std::endl;
+  }
+
+  Server server{ io_context, port, pool.get(), options.Has("incoming-cpu"),
+                 static_cast<int>(options.GetInt("busy-poll-us", 0)) };
+
+  // With a pool, this thread only accepts.
+  if (pool == nullptr && spin.count() > 0) {
+    utility::RunBusyPolling(io_context, spin);
+  } else {
+    io_context.run();
+  }
 
   return 0;
 }
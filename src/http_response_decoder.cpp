@@ -0,0 +1,434 @@
+#include "http_response_decoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#if HAVE_ZLIB
+#include "zlib.h"
+#endif  // HAVE_ZLIB
+
+namespace utility {
+
+namespace {
+
+// Size of the buffer for the inflated data.
+const std::size_t kInflateBufferSize = 16 * 1024;
+
+// Limit of the header block, to keep the buffering bounded.
+const std::size_t kMaxHeaderSize = 64 * 1024;
+
+std::string ToLower(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return str;
+}
+
+std::string Trim(const std::string& str) {
+  std::size_t begin = str.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  std::size_t end = str.find_last_not_of(" \t");
+  return str.substr(begin, end - begin + 1);
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+#if HAVE_ZLIB
+
+// Inflate gzip or deflate data with a fixed size output buffer.
+class HttpResponseDecoder::Inflater {
+public:
+  explicit Inflater(bool gzip)
+      : gzip_(gzip), initialized_(false), raw_(false), decided_(gzip),
+        ended_(false), buffer_(kInflateBufferSize) {
+    std::memset(&stream_, 0, sizeof(stream_));
+  }
+
+  ~Inflater() {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  bool Init() {
+    // For deflate, it's supposed to be zlib wrapped (RFC 7230), but some
+    // servers send raw deflate data; it's decided by the first two bytes,
+    // see Inflate().
+    if (!decided_) {
+      return true;
+    }
+
+    // For gzip, 16 + MAX_WBITS tells zlib to expect the gzip wrapper.
+    int window_bits = gzip_ ? 16 + MAX_WBITS : (raw_ ? -MAX_WBITS : MAX_WBITS);
+    initialized_ = inflateInit2(&stream_, window_bits) == Z_OK;
+    return initialized_;
+  }
+
+  bool Inflate(const char* data, std::size_t size, const Output& output,
+               std::size_t* decoded_size) {
+    if (!decided_) {
+      // Collect the first two bytes, however the data is split.
+      std::size_t used = (std::min)(size, 2 - head_.size());
+      head_.append(data, used);
+      data += used;
+      size -= used;
+
+      if (head_.size() < 2) {
+        return true;
+      }
+
+      decided_ = true;
+      raw_ = !IsZlibHeader(head_);
+      if (!Init() || !DoInflate(head_.data(), head_.size(), output,
+                                decoded_size)) {
+        return false;
+      }
+    }
+
+    return DoInflate(data, size, output, decoded_size);
+  }
+
+  // If the compressed stream has reached its end, i.e., isn't truncated.
+  bool ended() const {
+    return ended_;
+  }
+
+private:
+  // A zlib header (RFC 1950): deflate method, and the check bits make the
+  // first two bytes a multiple of 31.
+  static bool IsZlibHeader(const std::string& head) {
+    unsigned cmf = static_cast<unsigned char>(head[0]);
+    unsigned flg = static_cast<unsigned char>(head[1]);
+    return (cmf & 0x0F) == Z_DEFLATED && (cmf * 256 + flg) % 31 == 0;
+  }
+
+  bool DoInflate(const char* data, std::size_t size, const Output& output,
+                 std::size_t* decoded_size) {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = static_cast<uInt>(size);
+
+    while (stream_.avail_in > 0) {
+      stream_.next_out = reinterpret_cast<Bytef*>(buffer_.data());
+      stream_.avail_out = static_cast<uInt>(buffer_.size());
+
+      int ret = inflate(&stream_, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        return false;
+      }
+
+      std::size_t length = buffer_.size() - stream_.avail_out;
+      if (length > 0) {
+        *decoded_size += length;
+        output(buffer_.data(), length);
+      }
+
+      if (ret == Z_STREAM_END) {
+        ended_ = true;
+        if (stream_.avail_in == 0) {
+          break;
+        }
+        // Concatenated gzip members.
+        if (inflateReset(&stream_) != Z_OK) {
+          return false;
+        }
+        ended_ = false;
+      } else if (ret == Z_BUF_ERROR && length == 0) {
+        // No progress possible, need more input.
+        break;
+      }
+    }
+
+    return true;
+  }
+
+  bool gzip_;
+  bool initialized_;
+  bool raw_;
+  bool decided_;  // If zlib wrapped or raw deflate is known
+  bool ended_;
+  std::string head_;  // The first bytes of deflate data, until decided
+  z_stream stream_;
+  std::vector<char> buffer_;
+};
+
+#else
+
+class HttpResponseDecoder::Inflater {
+public:
+  bool Init() {
+    return false;
+  }
+
+  bool ended() const {
+    return false;
+  }
+};
+
+#endif  // HAVE_ZLIB
+
+// -----------------------------------------------------------------------------
+
+HttpResponseDecoder::HttpResponseDecoder(Output output)
+    : output_(std::move(output)),
+      state_(kHeaders),
+      chunked_(false),
+      has_content_length_(false),
+      content_length_(0),
+      remaining_(0),
+      wire_body_size_(0),
+      decoded_body_size_(0) {
+}
+
+HttpResponseDecoder::~HttpResponseDecoder() {
+}
+
+bool HttpResponseDecoder::SupportsCompression() {
+#if HAVE_ZLIB
+  return true;
+#else
+  return false;
+#endif  // HAVE_ZLIB
+}
+
+bool HttpResponseDecoder::Feed(const char* data, std::size_t size) {
+  while (size > 0) {
+    std::size_t used = 0;
+    bool complete = false;
+
+    switch (state_) {
+      case kHeaders: {
+        // Append to the header block until the empty line.
+        std::size_t old_size = line_.size();
+        line_.append(data, size);
+
+        std::size_t pos = line_.find("\r\n\r\n");
+        if (pos == std::string::npos) {
+          if (line_.size() > kMaxHeaderSize) {
+            return Fail();
+          }
+          return true;
+        }
+
+        used = pos + 4 - old_size;
+        line_.resize(pos + 2);  // Keep the last CRLF as line delimiter.
+
+        if (!ParseHeaders()) {
+          return Fail();
+        }
+        break;
+      }
+
+      case kChunkSize:
+        used = ReadLine(data, size, &complete);
+        if (complete) {
+          // Ignore chunk extensions.
+          char* end = nullptr;
+          remaining_ = std::strtoul(line_.c_str(), &end, 16);
+          if (end == line_.c_str()) {
+            return Fail();
+          }
+          line_.clear();
+          state_ = remaining_ > 0 ? kChunkData : kTrailers;
+        }
+        break;
+
+      case kChunkData:
+        used = (std::min)(size, remaining_);
+        if (!FeedBody(data, used)) {
+          return Fail();
+        }
+        remaining_ -= used;
+        if (remaining_ == 0) {
+          state_ = kChunkDataEnd;
+        }
+        break;
+
+      case kChunkDataEnd:
+        used = ReadLine(data, size, &complete);
+        if (complete) {
+          if (!line_.empty()) {
+            return Fail();
+          }
+          state_ = kChunkSize;
+        }
+        break;
+
+      case kTrailers:
+        used = ReadLine(data, size, &complete);
+        if (complete) {
+          if (line_.empty() && !EndBody()) {
+            return false;
+          }
+          line_.clear();
+        }
+        break;
+
+      case kBody:
+        used = has_content_length_ ? (std::min)(size, remaining_) : size;
+        if (!FeedBody(data, used)) {
+          return Fail();
+        }
+        if (has_content_length_) {
+          remaining_ -= used;
+          if (remaining_ == 0 && !EndBody()) {
+            return false;
+          }
+        }
+        break;
+
+      case kDone:
+        return true;
+
+      case kError:
+        return false;
+    }
+
+    data += used;
+    size -= used;
+  }
+
+  return true;
+}
+
+bool HttpResponseDecoder::Finish() {
+  if (state_ == kBody && !has_content_length_) {
+    EndBody();
+  }
+  return state_ == kDone;
+}
+
+bool HttpResponseDecoder::ParseHeaders() {
+  std::size_t begin = 0;
+  std::size_t end = line_.find("\r\n");
+
+  status_line_ = line_.substr(0, end);
+
+  // "HTTP/1.1 200 OK"
+  int status = 0;
+  std::size_t space = status_line_.find(' ');
+  if (space != std::string::npos) {
+    status = std::atoi(status_line_.c_str() + space + 1);
+  }
+
+  for (begin = end + 2; begin < line_.size(); begin = end + 2) {
+    end = line_.find("\r\n", begin);
+    if (!ParseHeaderLine(line_.substr(begin, end - begin))) {
+      return false;
+    }
+  }
+
+  line_.clear();
+
+  if (status / 100 == 1) {
+    // Interim response (e.g., 100 Continue), the real one follows.
+    status_line_.clear();
+    content_encoding_.clear();
+    chunked_ = false;
+    has_content_length_ = false;
+    return true;
+  }
+
+  if (!content_encoding_.empty() && content_encoding_ != "identity") {
+#if HAVE_ZLIB
+    if (content_encoding_ == "gzip" || content_encoding_ == "x-gzip") {
+      inflater_.reset(new Inflater(true));
+    } else if (content_encoding_ == "deflate") {
+      inflater_.reset(new Inflater(false));
+    }
+#endif  // HAVE_ZLIB
+
+    if (!inflater_ || !inflater_->Init()) {
+      return false;
+    }
+  }
+
+  if (status == 204 || status == 304) {
+    state_ = kDone;
+  } else if (chunked_) {
+    state_ = kChunkSize;
+  } else {
+    state_ = kBody;
+    remaining_ = content_length_;
+    if (has_content_length_ && content_length_ == 0) {
+      state_ = kDone;
+    }
+  }
+
+  return true;
+}
+
+bool HttpResponseDecoder::ParseHeaderLine(const std::string& line) {
+  std::size_t colon = line.find(':');
+  if (colon == std::string::npos) {
+    return false;
+  }
+
+  std::string name = ToLower(Trim(line.substr(0, colon)));
+  std::string value = Trim(line.substr(colon + 1));
+
+  if (name == "content-length") {
+    has_content_length_ = true;
+    content_length_ = std::strtoul(value.c_str(), nullptr, 10);
+  } else if (name == "transfer-encoding") {
+    chunked_ = ToLower(value).find("chunked") != std::string::npos;
+  } else if (name == "content-encoding") {
+    content_encoding_ = ToLower(value);
+  }
+
+  return true;
+}
+
+std::size_t HttpResponseDecoder::ReadLine(const char* data, std::size_t size,
+                                          bool* complete) {
+  const char* lf = static_cast<const char*>(std::memchr(data, '\n', size));
+
+  std::size_t used = lf == nullptr ? size : lf - data + 1;
+  line_.append(data, used);
+
+  *complete = lf != nullptr;
+  if (*complete) {
+    // Strip the CRLF.
+    line_.resize(line_.size() - 1);
+    if (!line_.empty() && line_.back() == '\r') {
+      line_.resize(line_.size() - 1);
+    }
+  }
+
+  return used;
+}
+
+bool HttpResponseDecoder::FeedBody(const char* data, std::size_t size) {
+  wire_body_size_ += size;
+
+#if HAVE_ZLIB
+  if (inflater_) {
+    return inflater_->Inflate(data, size, output_, &decoded_body_size_);
+  }
+#endif  // HAVE_ZLIB
+
+  decoded_body_size_ += size;
+  output_(data, size);
+  return true;
+}
+
+bool HttpResponseDecoder::EndBody() {
+  // A truncated gzip/deflate stream isn't complete, even if the body is by
+  // its framing. An empty body is, though (e.g., of a redirect).
+  if (inflater_ && wire_body_size_ > 0 && !inflater_->ended()) {
+    return Fail();
+  }
+  state_ = kDone;
+  return true;
+}
+
+bool HttpResponseDecoder::Fail() {
+  state_ = kError;
+  return false;
+}
+
+}  // namespace utility
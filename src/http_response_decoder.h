@@ -0,0 +1,108 @@
+#ifndef HTTP_RESPONSE_DECODER_H_
+#define HTTP_RESPONSE_DECODER_H_
+
+// Streaming decoder of HTTP/1.1 responses.
+// Feed it the raw bytes as they arrive from the socket; the decoded body is
+// passed to the output callback piece by piece, with bounded buffers.
+//   - Transfer-Encoding: chunked
+//   - Content-Encoding: gzip, deflate (need zlib, see HAVE_ZLIB)
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utility {
+
+class HttpResponseDecoder {
+public:
+  // Called with each piece of the decoded body.
+  typedef std::function<void(const char* data, std::size_t size)> Output;
+
+  explicit HttpResponseDecoder(Output output);
+
+  ~HttpResponseDecoder();
+
+  // If gzip and deflate could be decoded, i.e., whether the request could
+  // have "Accept-Encoding: gzip, deflate".
+  static bool SupportsCompression();
+
+  // Feed the next bytes from the wire.
+  // Return false on malformed or undecodable data.
+  // Bytes after the end of the response are ignored.
+  bool Feed(const char* data, std::size_t size);
+
+  // Tell the decoder that the stream has ended (EOF).
+  // Return false if the response is incomplete. A response without
+  // Content-Length and not chunked is completed by EOF. Whatever the
+  // framing, a truncated gzip or deflate stream makes the response invalid.
+  bool Finish();
+
+  // If the whole response has been decoded.
+  bool done() const { return state_ == kDone; }
+
+  const std::string& status_line() const { return status_line_; }
+
+  const std::string& content_encoding() const { return content_encoding_; }
+
+  // Body bytes received from the wire (after the headers, before decoding).
+  std::size_t wire_body_size() const { return wire_body_size_; }
+
+  // Body bytes after decoding.
+  std::size_t decoded_body_size() const { return decoded_body_size_; }
+
+private:
+  enum State {
+    kHeaders,
+    kChunkSize,
+    kChunkData,
+    kChunkDataEnd,
+    kTrailers,
+    kBody,       // Content-Length or until EOF
+    kDone,
+    kError,
+  };
+
+  class Inflater;
+
+  bool ParseHeaders();
+  bool ParseHeaderLine(const std::string& line);
+
+  // Consume a line ending with CRLF from |data|. Partial lines are kept in
+  // |line_|. Return the number of bytes consumed.
+  std::size_t ReadLine(const char* data, std::size_t size, bool* complete);
+
+  bool FeedBody(const char* data, std::size_t size);
+
+  // The body is complete by its framing (Content-Length, the last chunk or
+  // EOF). Fail if its compressed stream is truncated.
+  bool EndBody();
+
+  bool Fail();
+
+  Output output_;
+
+  State state_;
+
+  // Buffered header block, or a partial line (chunk size, trailers).
+  std::string line_;
+
+  std::string status_line_;
+  std::string content_encoding_;
+  bool chunked_;
+  bool has_content_length_;
+  std::size_t content_length_;
+
+  // Bytes left in the current chunk, or of the Content-Length body.
+  std::size_t remaining_;
+
+  std::size_t wire_body_size_;
+  std::size_t decoded_body_size_;
+
+  std::unique_ptr<Inflater> inflater_;
+};
+
+}  // namespace utility
+
+#endif  // HTTP_RESPONSE_DECODER_H_
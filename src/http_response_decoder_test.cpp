@@ -0,0 +1,151 @@
+// Tests of utility::HttpResponseDecoder with compressed bodies:
+//   - complete and truncated gzip streams, framed by Content-Length, by
+//     chunks and by EOF; a truncated stream is never a complete response;
+//   - zlib wrapped and raw deflate, fed one byte at a time.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "zlib.h"
+
+#include "http_response_decoder.h"
+
+enum Framing {
+  kContentLength,
+  kChunked,
+  kEof,
+};
+
+enum Format {
+  kGzip,
+  kZlib,
+  kRawDeflate,
+};
+
+#define EXPECT(condition)                                             \
+  if (!(condition)) {                                                 \
+    std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition    \
+              << std::endl;                                           \
+    return false;                                                     \
+  }
+
+std::string Compress(const std::string& data, Format format) {
+  int window_bits = format == kGzip ? 16 + MAX_WBITS
+                  : format == kZlib ? MAX_WBITS : -MAX_WBITS;
+
+  z_stream stream = z_stream();
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+               Z_DEFAULT_STRATEGY);
+
+  std::string output(deflateBound(&stream, data.size()) + 32, '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+  stream.avail_out = static_cast<uInt>(output.size());
+  deflate(&stream, Z_FINISH);
+  output.resize(output.size() - stream.avail_out);
+  deflateEnd(&stream);
+  return output;
+}
+
+std::string MakeResponse(const std::string& body, Framing framing,
+                         const std::string& encoding) {
+  std::ostringstream response;
+  response << "HTTP/1.1 200 OK\r\n";
+  response << "Content-Encoding: " << encoding << "\r\n";
+  if (framing == kContentLength) {
+    response << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+  } else if (framing == kChunked) {
+    response << "Transfer-Encoding: chunked\r\n\r\n";
+    for (std::size_t i = 0; i < body.size(); i += 7) {
+      std::string chunk = body.substr(i, 7);
+      response << std::hex << chunk.size() << "\r\n" << chunk << "\r\n";
+    }
+    response << "0\r\n\r\n";
+  } else {
+    response << "Connection: close\r\n\r\n" << body;
+  }
+  return response.str();
+}
+
+// Feed |response| |piece| bytes at a time, then EOF.
+// Return if the response is complete and valid.
+bool Decode(const std::string& response, std::size_t piece,
+            std::string* decoded) {
+  utility::HttpResponseDecoder decoder(
+      [decoded](const char* data, std::size_t size) {
+        decoded->append(data, size);
+      });
+
+  for (std::size_t i = 0; i < response.size(); i += piece) {
+    std::string bytes = response.substr(i, piece);
+    if (!decoder.Feed(bytes.data(), bytes.size())) {
+      return false;
+    }
+  }
+  return decoder.Finish();
+}
+
+std::string MakeBody() {
+  std::string body;
+  for (int i = 0; i < 1000; ++i) {
+    body += "line " + std::to_string(i) + "\n";
+  }
+  return body;
+}
+
+bool TestTruncated(Framing framing) {
+  std::string body = MakeBody();
+  std::string gzip = Compress(body, kGzip);
+
+  std::string decoded;
+  EXPECT(Decode(MakeResponse(gzip, framing, "gzip"), 4096, &decoded));
+  EXPECT(decoded == body);
+
+  // Cut inside the compressed stream; the framing itself is complete.
+  std::string truncated = gzip.substr(0, gzip.size() / 2);
+  decoded.clear();
+  EXPECT(!Decode(MakeResponse(truncated, framing, "gzip"), 4096, &decoded));
+
+  // Just the trailer (CRC and size) missing.
+  truncated = gzip.substr(0, gzip.size() - 8);
+  decoded.clear();
+  EXPECT(!Decode(MakeResponse(truncated, framing, "gzip"), 4096, &decoded));
+
+  return true;
+}
+
+bool TestDeflate(Format format) {
+  std::string body = MakeBody();
+  std::string deflate = Compress(body, format);
+
+  // One byte at a time: the first feed can't tell zlib from raw deflate.
+  std::string decoded;
+  EXPECT(Decode(MakeResponse(deflate, kContentLength, "deflate"), 1,
+                &decoded));
+  EXPECT(decoded == body);
+
+  decoded.clear();
+  EXPECT(Decode(MakeResponse(deflate, kEof, "deflate"), 1, &decoded));
+  EXPECT(decoded == body);
+
+  // Only one byte of the stream.
+  decoded.clear();
+  EXPECT(!Decode(MakeResponse(deflate.substr(0, 1), kContentLength,
+                              "deflate"), 1, &decoded));
+
+  return true;
+}
+
+int main() {
+  bool ok = true;
+  ok = TestTruncated(kContentLength) && ok;
+  ok = TestTruncated(kChunked) && ok;
+  ok = TestTruncated(kEof) && ok;
+  ok = TestDeflate(kZlib) && ok;
+  ok = TestDeflate(kRawDeflate) && ok;
+
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
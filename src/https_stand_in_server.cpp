@@ -0,0 +1,303 @@
+#include "https_stand_in_server.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "boost/asio/read_until.hpp"
+#include "boost/asio/ssl/stream.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/streambuf.hpp"
+#include "boost/asio/write.hpp"
+
+#include "tls_utility.h"
+
+using boost::asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+
+typedef ssl::stream<tcp::socket> ssl_socket;
+
+// -----------------------------------------------------------------------------
+
+class HttpsStandInServer::Session
+    : public std::enable_shared_from_this<Session> {
+public:
+  Session(tcp::socket socket, HttpsStandInServer& server)
+      : socket_(std::move(socket), server.ssl_context_),
+        timer_(socket_.get_executor()),
+        server_(server),
+        close_(false) {
+  }
+
+  void Start() {
+    // Don't hold back the small writes of the handshake, or the tail of a
+    // response, for a delayed ACK.
+    boost::system::error_code ec;
+    socket_.lowest_layer().set_option(tcp::no_delay(true), ec);
+
+    if (server_.config_.max_early_data > 0) {
+      StartWithEarlyData();
+      return;
+    }
+
+    DoHandshake();
+  }
+
+private:
+  void DoHandshake() {
+    socket_.async_handshake(ssl::stream_base::server,
+                            std::bind(&Session::OnHandshake,
+                                      shared_from_this(),
+                                      std::placeholders::_1));
+  }
+
+  // The early data can only be read with SSL_read_early_data() on the socket
+  // (see utility::DirectSocketIo). It's read into |request_| as if it was
+  // read by DoReadRequest(). Once there's no more early data, the stream
+  // completes the handshake, i.e., reads the Finished of the client.
+  void StartWithEarlyData() {
+    socket_.lowest_layer().non_blocking(true);
+
+    SSL* ssl = socket_.native_handle();
+    SSL_set_accept_state(ssl);
+    direct_io_.reset(new utility::DirectSocketIo(
+        ssl, static_cast<int>(socket_.lowest_layer().native_handle())));
+
+    ReadEarlyData();
+  }
+
+  void ReadEarlyData() {
+    SSL* ssl = socket_.native_handle();
+
+    for (;;) {
+      auto buffer = request_.prepare(4096);
+      std::size_t length = 0;
+      int ret = SSL_read_early_data(ssl, buffer.data(), buffer.size(),
+                                    &length);
+
+      if (ret == SSL_READ_EARLY_DATA_SUCCESS) {
+        request_.commit(length);
+        continue;
+      }
+
+      if (ret == SSL_READ_EARLY_DATA_FINISH) {
+        break;
+      }
+
+      // The ServerHello, etc. are written by SSL_read_early_data(), too.
+      int error = SSL_get_error(ssl, ret);
+      if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        socket_.lowest_layer().async_wait(
+            error == SSL_ERROR_WANT_READ ? tcp::socket::wait_read
+                                         : tcp::socket::wait_write,
+            std::bind(&Session::OnEarlyDataWait, shared_from_this(),
+                      std::placeholders::_1));
+      }
+      // Otherwise, the session is destroyed.
+      return;
+    }
+
+    if (SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED) {
+      ++server_.early_data_accepted_;
+    }
+
+    direct_io_.reset();
+    DoHandshake();
+  }
+
+  void OnEarlyDataWait(boost::system::error_code ec) {
+    if (!ec) {
+      ReadEarlyData();
+    }
+  }
+
+  void OnHandshake(boost::system::error_code ec) {
+    if (!ec) {
+      ++server_.connections_;
+      DoReadRequest();
+    }
+  }
+
+  void DoReadRequest() {
+    boost::asio::async_read_until(socket_, request_, "\r\n\r\n",
+                                  std::bind(&Session::OnReadRequest,
+                                            shared_from_this(),
+                                            std::placeholders::_1,
+                                            std::placeholders::_2));
+  }
+
+  void OnReadRequest(boost::system::error_code ec, std::size_t length) {
+    if (ec) {
+      return;
+    }
+
+    // Only the header block matters, a GET has no body.
+    std::string header(boost::asio::buffers_begin(request_.data()),
+                       boost::asio::buffers_begin(request_.data()) + length);
+    request_.consume(length);
+
+    close_ = !server_.config_.keep_alive ||
+             header.find("Connection: close") != std::string::npos ||
+             header.find("connection: close") != std::string::npos;
+
+    if (server_.config_.delay_ms > 0) {
+      timer_.expires_after(
+          std::chrono::milliseconds(server_.config_.delay_ms));
+      timer_.async_wait(std::bind(&Session::DoWriteResponse,
+                                  shared_from_this()));
+    } else {
+      DoWriteResponse();
+    }
+  }
+
+  void DoWriteResponse() {
+    const Config& config = server_.config_;
+    const std::string& body = server_.body_;
+
+    std::ostringstream header;
+    header << "HTTP/1.1 200 OK\r\n";
+    header << "Content-Type: text/plain\r\n";
+    if (config.chunked) {
+      header << "Transfer-Encoding: chunked\r\n";
+    } else {
+      header << "Content-Length: " << body.size() << "\r\n";
+    }
+    header << "Connection: " << (close_ ? "close" : "keep-alive") << "\r\n";
+    header << "\r\n";
+
+    std::size_t chunk_size = config.chunk_size > 0 ? config.chunk_size : 1;
+
+    // Gather the pieces of the response into one write; the body itself is
+    // never copied.
+    // Reserve before the first push_back, so that the buffers pointing into
+    // |strings_| stay valid: the header and one header per chunk.
+    strings_.clear();
+    strings_.reserve(config.chunked ? 1 + body.size() / chunk_size + 1 : 1);
+    strings_.push_back(header.str());
+
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(strings_.back()));
+
+    if (config.chunked) {
+      for (std::size_t i = 0; i < body.size(); i += chunk_size) {
+        std::size_t size = (std::min)(chunk_size, body.size() - i);
+
+        std::ostringstream chunk_header;
+        chunk_header << std::hex << size << "\r\n";
+        strings_.push_back(chunk_header.str());
+
+        buffers.push_back(boost::asio::buffer(strings_.back()));
+        buffers.push_back(boost::asio::buffer(body.data() + i, size));
+        buffers.push_back(boost::asio::buffer("\r\n", 2));
+      }
+
+      buffers.push_back(boost::asio::buffer("0\r\n\r\n", 5));
+    } else {
+      buffers.push_back(boost::asio::buffer(body));
+    }
+
+    boost::asio::async_write(socket_, buffers,
+                             std::bind(&Session::OnWriteResponse,
+                                       shared_from_this(),
+                                       std::placeholders::_1,
+                                       std::placeholders::_2));
+  }
+
+  void OnWriteResponse(boost::system::error_code ec, std::size_t length) {
+    if (ec) {
+      return;
+    }
+
+    ++server_.responses_;
+
+    if (close_) {
+      socket_.async_shutdown(std::bind(&Session::OnShutdown,
+                                       shared_from_this(),
+                                       std::placeholders::_1));
+    } else {
+      DoReadRequest();
+    }
+  }
+
+  void OnShutdown(boost::system::error_code ec) {
+    boost::system::error_code ignored_ec;
+    socket_.lowest_layer().close(ignored_ec);
+  }
+
+  ssl_socket socket_;
+  boost::asio::steady_timer timer_;
+
+  // While reading the early data.
+  std::unique_ptr<utility::DirectSocketIo> direct_io_;
+
+  HttpsStandInServer& server_;
+
+  boost::asio::streambuf request_;
+
+  // Header and chunk headers of the response being written.
+  std::vector<std::string> strings_;
+
+  // Close the connection after the response.
+  bool close_;
+};
+
+// -----------------------------------------------------------------------------
+
+HttpsStandInServer::HttpsStandInServer(boost::asio::io_context& io_context,
+                                       unsigned short port,
+                                       const Config& config)
+    : config_(config),
+      acceptor_(io_context,
+                tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)),
+      ssl_context_(ssl::context::sslv23),
+      responses_(0),
+      connections_(0),
+      early_data_accepted_(0) {
+  ssl_context_.set_options(ssl::context::default_workarounds |
+                           ssl::context::no_sslv2 |
+                           ssl::context::single_dh_use);
+
+  ssl_context_.set_password_callback(
+      [](std::size_t, ssl::context::password_purpose) {
+        return std::string("test");
+      });
+
+  ssl_context_.use_certificate_chain_file(config_.cert_dir + "server.pem");
+  ssl_context_.use_private_key_file(config_.cert_dir + "server.pem",
+                                    ssl::context::pem);
+  ssl_context_.use_tmp_dh_file(config_.cert_dir + "dh2048.pem");
+
+  // Only HTTP/1.1 is spoken.
+  alpn_protocols_ = utility::EncodeAlpnProtocols({ "http/1.1" });
+  utility::SetAlpnSelection(ssl_context_, &alpn_protocols_);
+
+  if (config_.max_early_data > 0) {
+    SSL_CTX_set_max_early_data(ssl_context_.native_handle(),
+                               config_.max_early_data);
+  }
+
+  // Printable and easy to verify: "0123456789abcdef0123...".
+  static const char kPattern[] = "0123456789abcdef";
+  body_.resize(config_.body_size);
+  for (std::size_t i = 0; i < body_.size(); ++i) {
+    body_[i] = kPattern[i % 16];
+  }
+
+  DoAccept();
+}
+
+unsigned short HttpsStandInServer::port() const {
+  return acceptor_.local_endpoint().port();
+}
+
+void HttpsStandInServer::DoAccept() {
+  acceptor_.async_accept(
+      [this](boost::system::error_code ec, tcp::socket socket) {
+        if (!ec) {
+          std::make_shared<Session>(std::move(socket), *this)->Start();
+        }
+        DoAccept();
+      });
+}
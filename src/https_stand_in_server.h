@@ -0,0 +1,83 @@
+#ifndef HTTPS_STAND_IN_SERVER_H_
+#define HTTPS_STAND_IN_SERVER_H_
+
+// A local HTTPS (HTTP/1.1 over TLS) server standing in for the real hosts
+// (e.g., www.boost.org) so that the HTTPS clients can be run and benchmarked
+// offline over loopback.
+// Every request is answered with a generated body of the configured size.
+// Based on the Server/Session of |ssl_server|.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/asio/ssl/context.hpp"
+
+class HttpsStandInServer {
+public:
+  struct Config {
+    // Size of the response body.
+    std::size_t body_size = 1024;
+
+    // Delay before each response is sent.
+    int delay_ms = 0;
+
+    // Send the body with "Transfer-Encoding: chunked" instead of
+    // Content-Length.
+    bool chunked = false;
+    std::size_t chunk_size = 4096;
+
+    // Keep the connection alive after a response unless the client asks
+    // for "Connection: close". Otherwise always close.
+    bool keep_alive = false;
+
+    // Directory of server.pem and dh2048.pem.
+    std::string cert_dir;
+
+    // Accept up to this many bytes of TLS 1.3 early data (0-RTT) on a
+    // resumed session; 0 to reject it.
+    // The request sent as early data is answered once the handshake has
+    // completed, i.e., with no 0.5-RTT data.
+    std::uint32_t max_early_data = 0;
+  };
+
+  // Listen on the loopback address. Pass 0 as port to pick a free one.
+  HttpsStandInServer(boost::asio::io_context& io_context,
+                     unsigned short port, const Config& config);
+
+  unsigned short port() const;
+
+  // Number of responses sent completely.
+  std::size_t responses() const { return responses_; }
+
+  // Number of TLS connections accepted.
+  std::size_t connections() const { return connections_; }
+
+  // Number of connections with early data accepted.
+  std::size_t early_data_accepted() const { return early_data_accepted_; }
+
+private:
+  class Session;
+
+  void DoAccept();
+
+  Config config_;
+
+  boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::ssl::context ssl_context_;
+
+  // The shared body all responses are sliced from.
+  std::string body_;
+
+  // ALPN protocols, encoded.
+  std::string alpn_protocols_;
+
+  std::atomic<std::size_t> responses_;
+  std::atomic<std::size_t> connections_;
+  std::atomic<std::size_t> early_data_accepted_;
+};
+
+#endif  // HTTPS_STAND_IN_SERVER_H_
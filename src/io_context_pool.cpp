@@ -0,0 +1,104 @@
+#include "io_context_pool.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "low_latency_runner.h"
+#include "utility.h"
+
+namespace utility {
+
+IoContextPool::IoContextPool(std::size_t size, Policy policy)
+    : policy_(policy), next_(0),
+      busy_poll_(std::chrono::steady_clock::duration::zero()) {
+  if (size == 0) {
+    size = 1;
+  }
+  for (std::size_t i = 0; i < size; ++i) {
+    contexts_.emplace_back(new Context);
+  }
+}
+
+IoContextPool::~IoContextPool() {
+  Stop();
+  Join();
+}
+
+void IoContextPool::SetCpus(std::size_t index, const std::vector<int>& cpus) {
+  contexts_[index]->cpus = cpus;
+}
+
+void IoContextPool::Start() {
+  for (std::unique_ptr<Context>& context : contexts_) {
+    Context* c = context.get();
+    std::chrono::steady_clock::duration busy_poll = busy_poll_;
+    threads_.emplace_back([c, busy_poll]() {
+      if (!c->cpus.empty() && !SetThreadAffinity(c->cpus)) {
+        std::cerr << "Failed to pin the thread to the CPUs." << std::endl;
+      }
+      if (busy_poll > std::chrono::steady_clock::duration::zero()) {
+        RunBusyPolling(c->io_context, busy_poll);
+      } else {
+        c->io_context.run();
+      }
+    });
+  }
+}
+
+void IoContextPool::Stop() {
+  for (std::unique_ptr<Context>& context : contexts_) {
+    context->work.reset();
+    context->io_context.stop();
+  }
+}
+
+void IoContextPool::Join() {
+  for (std::thread& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+std::size_t IoContextPool::Acquire() {
+  std::size_t index = 0;
+
+  if (policy_ == kRoundRobin) {
+    index = next_.fetch_add(1, std::memory_order_relaxed) % contexts_.size();
+  } else {
+    // Racy with concurrent Acquire() or Release(), which only makes the load
+    // a little less even. Ties go round-robin, so that the io_contexts are
+    // also used in turn while the sessions are short.
+    std::size_t start =
+        next_.fetch_add(1, std::memory_order_relaxed) % contexts_.size();
+    std::size_t least = static_cast<std::size_t>(-1);
+    for (std::size_t i = 0; i < contexts_.size(); ++i) {
+      std::size_t j = (start + i) % contexts_.size();
+      std::size_t sessions = contexts_[j]->sessions;
+      if (sessions < least) {
+        least = sessions;
+        index = j;
+      }
+    }
+  }
+
+  contexts_[index]->sessions.fetch_add(1);
+  return index;
+}
+
+std::size_t IoContextPool::Acquire(int cpu) {
+  for (std::size_t i = 0; i < contexts_.size(); ++i) {
+    const std::vector<int>& cpus = contexts_[i]->cpus;
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+      contexts_[i]->sessions.fetch_add(1);
+      return i;
+    }
+  }
+  return Acquire();
+}
+
+void IoContextPool::Release(std::size_t index) {
+  contexts_[index]->sessions.fetch_sub(1);
+}
+
+}  // namespace utility
@@ -0,0 +1,122 @@
+#ifndef IO_CONTEXT_POOL_H_
+#define IO_CONTEXT_POOL_H_
+
+// A pool of io_contexts, each run by its own thread, to spread the sessions
+// (connections) of a server across the CPUs: the handlers of a session all run
+// on one thread, so a session needs no strand.
+// Each io_context has a work guard, so its thread keeps running while it has
+// no session, until Stop().
+// A new session is assigned to an io_context either round-robin, or to the one
+// with the fewest live sessions (the sessions are counted by Acquire() and
+// Release()); the latter keeps the load even when the sessions don't live
+// equally long.
+// E.g., with an acceptor:
+//   std::size_t index = pool.Acquire();
+//   acceptor.async_accept(pool.Get(index), handler);  // The peer socket is
+//                                                     // on io_context |index|.
+//   ...
+//   pool.Release(index);  // When the session ends.
+// The threads may be pinned to CPUs with SetCpus() (Linux only), so that the
+// state of a session stays in the caches (and on the NUMA node) of the CPUs of
+// its thread; create the sessions on their threads (e.g., by posting to the
+// io_context) for their memory to come from that node. With Acquire(cpu), a
+// session goes to the io_context pinned to the CPU which processes the packets
+// of its socket (see GetIncomingCpu() in utility.h).
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/executor_work_guard.hpp"
+#include "boost/asio/io_context.hpp"
+
+namespace utility {
+
+class IoContextPool {
+public:
+  enum Policy {
+    kRoundRobin,
+    kLeastLoaded,
+  };
+
+  // |size| io_contexts (at least one).
+  IoContextPool(std::size_t size, Policy policy);
+
+  // Stop and join the threads.
+  ~IoContextPool();
+
+  IoContextPool(const IoContextPool&) = delete;
+  IoContextPool& operator=(const IoContextPool&) = delete;
+
+  // Pin the thread of io_context |index| to the |cpus|. Call before Start().
+  void SetCpus(std::size_t index, const std::vector<int>& cpus);
+
+  // Busy-poll the io_contexts for |budget| before blocking (see
+  // RunBusyPolling()); zero to block right away. Call before Start().
+  void SetBusyPoll(std::chrono::steady_clock::duration budget) {
+    busy_poll_ = budget;
+  }
+
+  // Start a thread for each io_context.
+  void Start();
+
+  // Stop the io_contexts; the threads exit after the handlers running.
+  void Stop();
+
+  // Wait for the threads to exit.
+  void Join();
+
+  std::size_t size() const { return contexts_.size(); }
+
+  Policy policy() const { return policy_; }
+
+  boost::asio::io_context& Get(std::size_t index) {
+    return contexts_[index]->io_context;
+  }
+
+  // Pick an io_context for a new session by the policy and count the session
+  // on it. Return the index of the io_context. Thread safe.
+  std::size_t Acquire();
+
+  // Like Acquire(), but to the io_context pinned to |cpu|, if any. Thread
+  // safe.
+  std::size_t Acquire(int cpu);
+
+  // The session on io_context |index| has ended. Thread safe.
+  void Release(std::size_t index);
+
+  // The live sessions on io_context |index|.
+  std::size_t sessions(std::size_t index) const {
+    return contexts_[index]->sessions;
+  }
+
+private:
+  typedef boost::asio::executor_work_guard<
+      boost::asio::io_context::executor_type> WorkGuard;
+
+  struct Context {
+    Context() : io_context(1), work(io_context.get_executor()), sessions(0) {
+    }
+
+    // Only run by its own thread.
+    boost::asio::io_context io_context;
+    WorkGuard work;
+    std::atomic<std::size_t> sessions;
+
+    // Pinned to, if not empty.
+    std::vector<int> cpus;
+  };
+
+  Policy policy_;
+  std::vector<std::unique_ptr<Context>> contexts_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> next_;
+  std::chrono::steady_clock::duration busy_poll_;
+};
+
+}  // namespace utility
+
+#endif  // IO_CONTEXT_POOL_H_
@@ -0,0 +1,156 @@
+#include "low_latency_runner.h"
+
+#include <thread>
+
+namespace utility {
+
+namespace {
+
+// Block at most this long without checking the deadlines again.
+const LowLatencyRunner::duration kMaxBlock = std::chrono::seconds(1);
+
+// The reactor may time out this much later than asked.
+const LowLatencyRunner::duration kReactorResolution =
+    std::chrono::milliseconds(1);
+
+}  // namespace
+
+LowLatencyRunner::LowLatencyRunner(boost::asio::io_context& io_context,
+                                   const Options& options)
+    : io_context_(io_context), options_(options), spinning_(false),
+      spins_(0), blocks_(0) {
+}
+
+void LowLatencyRunner::Expect(time_point deadline) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  deadlines_.push(deadline);
+}
+
+std::size_t LowLatencyRunner::Run() {
+  std::size_t count = 0;
+  bool spinning = false;  // If this thread is the spinning one
+
+  while (!io_context_.stopped()) {
+    count += io_context_.poll();
+
+    time_point now = clock_type::now();
+    time_point deadline;
+    bool expected = NextDeadline(now, &deadline);
+    time_point spin_start = expected ? deadline - options_.spin_before
+                                     : now + kMaxBlock;
+
+    if (expected && now >= spin_start) {
+      if (spinning || StartSpinning()) {
+        // Spin: poll again right away.
+        spinning = true;
+        spins_.fetch_add(1, std::memory_order_relaxed);
+        if (options_.yield) {
+          std::this_thread::yield();
+        }
+      } else {
+        WaitSpinning(deadline + options_.spin_after);
+      }
+      continue;
+    }
+
+    if (spinning) {
+      spinning = false;
+      StopSpinning();
+    }
+
+    // Block until a handler runs, or it's time to spin.
+    blocks_.fetch_add(1, std::memory_order_relaxed);
+    time_point until = spin_start - kReactorResolution;
+    if (IsSpinning()) {
+      WaitSpinning(spin_start);
+    } else if (now < until) {
+      count += io_context_.run_one_until(until);
+    } else {
+      Sleep(spin_start);
+    }
+  }
+
+  if (spinning) {
+    StopSpinning();
+  }
+
+  return count;
+}
+
+bool LowLatencyRunner::NextDeadline(time_point now, time_point* deadline) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  while (!deadlines_.empty() &&
+         deadlines_.top() + options_.spin_after < now) {
+    deadlines_.pop();
+  }
+
+  if (deadlines_.empty()) {
+    return false;
+  }
+  *deadline = deadlines_.top();
+  return true;
+}
+
+bool LowLatencyRunner::StartSpinning() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (spinning_) {
+    return false;
+  }
+  spinning_ = true;
+  return true;
+}
+
+bool LowLatencyRunner::IsSpinning() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return spinning_;
+}
+
+void LowLatencyRunner::WaitSpinning(time_point time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  spinning_stopped_.wait_until(lock, time, [this]() { return !spinning_; });
+}
+
+void LowLatencyRunner::StopSpinning() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spinning_ = false;
+  }
+  spinning_stopped_.notify_all();
+}
+
+void LowLatencyRunner::Sleep(time_point time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  spinning_stopped_.wait_until(lock, time);
+}
+
+// -----------------------------------------------------------------------------
+
+std::size_t RunBusyPolling(boost::asio::io_context& io_context,
+                           LowLatencyRunner::duration budget) {
+  typedef LowLatencyRunner::clock_type clock_type;
+
+  std::size_t count = 0;
+
+  while (!io_context.stopped()) {
+    clock_type::time_point idle_since = clock_type::now();
+    for (;;) {
+      std::size_t n = io_context.poll();
+      if (io_context.stopped()) {
+        return count + n;
+      }
+      if (n > 0) {
+        count += n;
+        idle_since = clock_type::now();
+      } else if (clock_type::now() - idle_since >= budget) {
+        break;
+      }
+    }
+
+    count += io_context.run_one();
+  }
+
+  return count;
+}
+
+}  // namespace utility
@@ -0,0 +1,122 @@
+#ifndef LOW_LATENCY_RUNNER_H_
+#define LOW_LATENCY_RUNNER_H_
+
+// An opt-in run mode of io_context for precise timers.
+// A timer expiring while the thread blocks in epoll (or another reactor)
+// completes late by the wakeup latency of the thread, tens to hundreds of
+// microseconds. Instead of io_context::run(), call LowLatencyRunner::Run():
+// the thread still blocks while there's nothing to do, but from a little
+// before an expected deadline until a little after it, it keeps polling the
+// io_context instead (spinning).
+// Tell the runner about the deadlines with Expect(), e.g., right after arming
+// a timer:
+//   timer.expires_after(std::chrono::milliseconds(1));
+//   timer.async_wait(handler);
+//   runner.Expect(timer.expiry());
+// The longer the spin window, the more CPU is burnt; the shorter, the more
+// likely the thread has to wake up for a deadline.
+// The reactor (e.g., epoll_wait) only times out in whole milliseconds, so the
+// threads leave it a millisecond before they start spinning, and wait for the
+// rest of the time outside of the io_context: a thread blocking in the
+// reactor would keep the spinning one from polling it.
+// With several threads, only one of them spins at a time (only one thread can
+// poll the reactor anyway); the others wait for it to stop, so that they
+// don't take the CPU from it, nor block in the reactor.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+
+namespace utility {
+
+class LowLatencyRunner {
+public:
+  typedef std::chrono::steady_clock clock_type;
+  typedef clock_type::duration duration;
+  typedef clock_type::time_point time_point;
+
+  struct Options {
+    // Start spinning this long before an expected deadline.
+    duration spin_before = std::chrono::microseconds(200);
+
+    // Keep spinning this long after it, until the timer has completed.
+    duration spin_after = std::chrono::microseconds(50);
+
+    // Yield the CPU between polls: less CPU for the spinning thread, but
+    // more jitter if there are other threads to run.
+    bool yield = false;
+  };
+
+  LowLatencyRunner(boost::asio::io_context& io_context,
+                   const Options& options);
+
+  // A deadline to be precise for. Thread safe.
+  // If Run() is blocking in another thread, it only sees the deadline when
+  // it runs its next handler (or in a second at most).
+  void Expect(time_point deadline);
+
+  // Run the io_context until it's out of work or stopped, like
+  // io_context::run(). It may be called from several threads.
+  // Return the number of handlers executed.
+  std::size_t Run();
+
+  // The polls while spinning, and the times the loop has blocked.
+  std::size_t spins() const { return spins_; }
+  std::size_t blocks() const { return blocks_; }
+
+private:
+  // The earliest deadline not passed by more than |spin_after|.
+  bool NextDeadline(time_point now, time_point* deadline);
+
+  // Become the spinning thread; false if another thread is spinning.
+  bool StartSpinning();
+
+  void StopSpinning();
+
+  bool IsSpinning();
+
+  // Wait outside of the io_context until the spinning thread stops, or
+  // until |time|.
+  void WaitSpinning(time_point time);
+
+  // Wait outside of the io_context until |time|.
+  void Sleep(time_point time);
+
+
+  boost::asio::io_context& io_context_;
+  Options options_;
+
+  std::mutex mutex_;
+  std::priority_queue<time_point, std::vector<time_point>,
+                      std::greater<time_point>> deadlines_;
+
+  bool spinning_;
+  std::condition_variable spinning_stopped_;
+
+  std::atomic<std::size_t> spins_;
+  std::atomic<std::size_t> blocks_;
+};
+
+// -----------------------------------------------------------------------------
+
+// Run the io_context like io_context::run(), but busy-poll it: keep calling
+// poll() until there has been nothing to do for |budget|, and only then block
+// for the next handler (run_one()). While spinning, a completion is picked up
+// without waking up a thread, i.e., without a context switch and the scheduler
+// latency, at the cost of a CPU burnt for up to |budget| after each handler.
+// For a thread with a CPU of its own; with more threads than CPUs, the
+// spinning takes the CPU from the others.
+// Return the number of handlers executed.
+std::size_t RunBusyPolling(boost::asio::io_context& io_context,
+                           LowLatencyRunner::duration budget);
+
+}  // namespace utility
+
+#endif  // LOW_LATENCY_RUNNER_H_
@@ -0,0 +1,69 @@
+#include "periodic_timer.h"
+
+#include <utility>
+
+namespace utility {
+
+PeriodicTimer::PeriodicTimer(boost::asio::io_context& io_context,
+                             const duration& period, bool skip_missed)
+    : timer_(io_context), period_(period), skip_missed_(skip_missed),
+      running_(false), ticks_(0), skipped_(0),
+      state_(std::make_shared<State>(this)) {
+}
+
+PeriodicTimer::~PeriodicTimer() {
+  // The pending wait is cancelled by the destructor of |timer_|; its handler
+  // keeps |state_| alive until it has run (or been destroyed).
+  state_->owner = nullptr;
+}
+
+void PeriodicTimer::Start(Callback callback) {
+  callback_ = std::move(callback);
+  running_ = true;
+  ++state_->generation;
+
+  deadline_ = clock_type::now() + period_;
+  Wait();
+}
+
+void PeriodicTimer::Stop() {
+  running_ = false;
+  ++state_->generation;
+  timer_.cancel();
+}
+
+void PeriodicTimer::Wait() {
+  timer_.expires_at(deadline_);
+  timer_.async_wait(TickHandler(state_));
+}
+
+void PeriodicTimer::OnTick(boost::system::error_code ec,
+                           std::size_t generation) {
+  if (ec || !running_ || generation != state_->generation) {
+    return;
+  }
+
+  // Rearm from the deadline, not from now.
+  std::size_t ticks = 1;
+  deadline_ += period_;
+
+  if (skip_missed_) {
+    time_point now = clock_type::now();
+    if (deadline_ <= now) {
+      std::size_t missed =
+          static_cast<std::size_t>((now - deadline_) / period_) + 1;
+      deadline_ += period_ * static_cast<duration::rep>(missed);
+      ticks += missed;
+      skipped_ += missed;
+    }
+  }
+
+  ticks_ += ticks;
+
+  // Wait before the callback so that it may Stop().
+  Wait();
+
+  callback_(ticks);
+}
+
+}  // namespace utility
@@ -0,0 +1,197 @@
+#ifndef PERIODIC_TIMER_H_
+#define PERIODIC_TIMER_H_
+
+// A periodic timer on top of steady_timer.
+// Compared to rearming the timer with expires_after() and a new std::bind()
+// handler on each tick (see |timer6_args| and |timer7_memfunc|):
+//   - Each period starts from the previous deadline instead of from when the
+//     handler runs, so the latencies of the ticks don't add up (no drift).
+//   - The wait handler always uses the same preallocated memory (see
+//     HandlerMemory), so a tick doesn't allocate.
+//     The memory is shared with the pending wait, so the timer may be
+//     destroyed (or stopped and restarted) while a wait is pending or its
+//     aborted handler is still queued.
+//   - Optionally, missed ticks (e.g., the loop was busy for a few periods) are
+//     skipped instead of firing back to back to catch up.
+// E.g.,
+//   utility::PeriodicTimer timer{ io_context, std::chrono::seconds(1) };
+//   timer.Start([](std::size_t ticks) { std::cout << "Tick!" << std::endl; });
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+namespace utility {
+
+// Memory for one handler at a time, used through HandlerAllocator.
+// Falls back to the heap if the block is in use or too small.
+class HandlerMemory {
+public:
+  HandlerMemory() : in_use_(false) {
+  }
+
+  HandlerMemory(const HandlerMemory&) = delete;
+  HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+  void* Allocate(std::size_t size) {
+    if (!in_use_ && size <= sizeof(storage_)) {
+      in_use_ = true;
+      return &storage_;
+    }
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* pointer) {
+    if (pointer == &storage_) {
+      in_use_ = false;
+    } else {
+      ::operator delete(pointer);
+    }
+  }
+
+private:
+  // Enough for the wait operation of steady_timer.
+  typename std::aligned_storage<256>::type storage_;
+  bool in_use_;
+};
+
+// The associated allocator of a handler, see boost::asio::associated_allocator.
+template <typename T>
+class HandlerAllocator {
+public:
+  typedef T value_type;
+
+  explicit HandlerAllocator(HandlerMemory& memory) : memory_(memory) {
+  }
+
+  template <typename U>
+  HandlerAllocator(const HandlerAllocator<U>& other) noexcept
+      : memory_(other.memory_) {
+  }
+
+  T* allocate(std::size_t n) const {
+    return static_cast<T*>(memory_.Allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* pointer, std::size_t /*n*/) const {
+    memory_.Deallocate(pointer);
+  }
+
+  bool operator==(const HandlerAllocator& other) const noexcept {
+    return &memory_ == &other.memory_;
+  }
+
+  bool operator!=(const HandlerAllocator& other) const noexcept {
+    return &memory_ != &other.memory_;
+  }
+
+private:
+  template <typename>
+  friend class HandlerAllocator;
+
+  HandlerMemory& memory_;
+};
+
+// -----------------------------------------------------------------------------
+
+class PeriodicTimer {
+public:
+  typedef std::chrono::steady_clock clock_type;
+  typedef clock_type::duration duration;
+  typedef clock_type::time_point time_point;
+
+  // Called on each tick with the number of periods elapsed since the last
+  // call: 1, or more if missed ticks were skipped.
+  typedef std::function<void(std::size_t ticks)> Callback;
+
+  PeriodicTimer(boost::asio::io_context& io_context, const duration& period,
+                bool skip_missed = false);
+
+  ~PeriodicTimer();
+
+  PeriodicTimer(const PeriodicTimer&) = delete;
+  PeriodicTimer& operator=(const PeriodicTimer&) = delete;
+
+  // Tick every period from now on, until Stop().
+  void Start(Callback callback);
+
+  void Stop();
+
+  const duration& period() const { return period_; }
+
+  // The scheduled time of the next tick.
+  time_point deadline() const { return deadline_; }
+
+  // The ticks so far, including the skipped ones.
+  std::size_t ticks() const { return ticks_; }
+
+  std::size_t skipped() const { return skipped_; }
+
+private:
+  // Shared by the timer and its pending wait handlers, so that a handler
+  // still queued after the timer has been destroyed finds its memory and
+  // knows not to call back.
+  struct State {
+    explicit State(PeriodicTimer* owner) : owner(owner), generation(0) {
+    }
+
+    PeriodicTimer* owner;  // nullptr once destroyed
+
+    // Incremented by Start() and Stop(), so that a tick of a previous run
+    // already queued (i.e., too late to cancel) is ignored.
+    std::size_t generation;
+
+    HandlerMemory memory;
+  };
+
+  // The wait handler, allocated from |State::memory|.
+  class TickHandler {
+  public:
+    typedef HandlerAllocator<TickHandler> allocator_type;
+
+    explicit TickHandler(const std::shared_ptr<State>& state)
+        : state_(state), generation_(state->generation) {
+    }
+
+    allocator_type get_allocator() const noexcept {
+      return allocator_type(state_->memory);
+    }
+
+    void operator()(boost::system::error_code ec) {
+      if (state_->owner != nullptr) {
+        state_->owner->OnTick(ec, generation_);
+      }
+    }
+
+  private:
+    std::shared_ptr<State> state_;
+    std::size_t generation_;
+  };
+
+  void Wait();
+
+  void OnTick(boost::system::error_code ec, std::size_t generation);
+
+  boost::asio::steady_timer timer_;
+  duration period_;
+  bool skip_missed_;
+
+  Callback callback_;
+  bool running_;
+
+  time_point deadline_;
+  std::size_t ticks_;
+  std::size_t skipped_;
+
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace utility
+
+#endif  // PERIODIC_TIMER_H_
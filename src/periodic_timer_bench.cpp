@@ -0,0 +1,203 @@
+// Allocations per tick and drift of periodic timers.
+//   - rebind:  the pattern of |timer7_memfunc|, i.e., expires_after() and a
+//              new std::bind() handler on each tick.
+//   - periodic: utility::PeriodicTimer, catching up on missed ticks.
+//   - skip:     utility::PeriodicTimer, skipping missed ticks.
+// The drift is how far the last tick is behind the schedule, i.e., start +
+// ticks * period. Optionally, the loop stalls now and then for a few periods
+// (--stall-every=<ticks>) to show how missed ticks are handled.
+// Allocations are counted by replacing the global operator new.
+// E.g.,
+//   $ periodic_timer_bench --ticks=1000000 --period-us=20
+//   $ periodic_timer_bench --ticks=100000 --period-us=100 --stall-every=1000
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+#include "periodic_timer.h"
+#include "utility.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+static std::atomic<std::size_t> g_allocations{ 0 };
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = std::malloc(size != 0 ? size : 1);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+// -----------------------------------------------------------------------------
+
+struct Options {
+  std::size_t ticks;
+  Clock::duration period;
+  std::size_t stall_every;  // 0 to never stall
+  Clock::duration stall;
+};
+
+struct Result {
+  std::size_t ticks = 0;      // Including the skipped ones
+  std::size_t skipped = 0;
+  std::size_t allocations = 0;
+  Clock::duration drift = Clock::duration::zero();
+};
+
+void Stall(const Options& options, std::size_t tick) {
+  if (options.stall_every > 0 && tick % options.stall_every == 0) {
+    std::this_thread::sleep_for(options.stall);
+  }
+}
+
+// The pattern of |timer7_memfunc|.
+class Rebinder {
+public:
+  Rebinder(boost::asio::io_context& io_context, const Options& options)
+      : timer_(io_context), options_(options), ticks_(0) {
+  }
+
+  void Start() {
+    timer_.expires_after(options_.period);
+    timer_.async_wait(std::bind(&Rebinder::OnTick, this,
+                                std::placeholders::_1));
+  }
+
+  std::size_t ticks() const { return ticks_; }
+
+private:
+  void OnTick(boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+
+    ++ticks_;
+    Stall(options_, ticks_);
+
+    if (ticks_ < options_.ticks) {
+      Start();
+    }
+  }
+
+  boost::asio::steady_timer timer_;
+  const Options& options_;
+  std::size_t ticks_;
+};
+
+Result RunRebind(const Options& options) {
+  boost::asio::io_context io_context(1);
+  Rebinder rebinder(io_context, options);
+
+  Clock::time_point start = Clock::now();
+  std::size_t allocations = g_allocations;
+
+  rebinder.Start();
+  io_context.run();
+
+  Result result;
+  result.allocations = g_allocations - allocations;
+  result.ticks = rebinder.ticks();
+  result.drift = Clock::now() - (start + options.period *
+                                 static_cast<Clock::rep>(result.ticks));
+  return result;
+}
+
+Result RunPeriodic(const Options& options, bool skip_missed) {
+  boost::asio::io_context io_context(1);
+  utility::PeriodicTimer timer(io_context, options.period, skip_missed);
+
+  Clock::time_point start = Clock::now();
+  std::size_t allocations = 0;
+
+  // Count from the first tick, i.e., after the callback has been stored.
+  timer.Start([&](std::size_t ticks) {
+    if (timer.ticks() == ticks) {
+      allocations = g_allocations;
+    }
+    Stall(options, timer.ticks());
+    if (timer.ticks() >= options.ticks) {
+      timer.Stop();
+    }
+  });
+  io_context.run();
+
+  Result result;
+  result.allocations = g_allocations - allocations;
+  result.ticks = timer.ticks();
+  result.skipped = timer.skipped();
+  result.drift = Clock::now() - (start + options.period *
+                                 static_cast<Clock::rep>(result.ticks));
+  return result;
+}
+
+void Print(const std::string& name, const Result& result) {
+  std::chrono::duration<double, std::milli> drift = result.drift;
+  std::cout << "  " << std::left << std::setw(10) << name << std::right
+            << "ticks: " << result.ticks << ", skipped: " << result.skipped
+            << std::fixed << std::setprecision(3)
+            << ", allocations: " << result.allocations
+            << " (" << static_cast<double>(result.allocations) / result.ticks
+            << " per tick)"
+            << ", drift: " << drift.count() << " ms" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --ticks=<n>           Default: 1000000" << std::endl;
+  std::cout << "    --period-us=<us>      Default: 20" << std::endl;
+  std::cout << "    --stall-every=<n>     Stall every n ticks. Default: 0"
+            << std::endl;
+  std::cout << "    --stall-periods=<n>   Stall for n periods. Default: 3"
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options args(argc, argv);
+
+  if (args.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  Options options;
+  options.ticks = args.GetInt("ticks", 1000000);
+  options.period = std::chrono::microseconds(args.GetInt("period-us", 20));
+  options.stall_every = args.GetInt("stall-every", 0);
+  options.stall = options.period * args.GetInt("stall-periods", 3);
+
+  if (options.ticks == 0 || options.period <= Clock::duration::zero()) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::cout << "ticks: " << options.ticks << ", period: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   options.period).count() << " us" << std::endl;
+
+  Print("rebind", RunRebind(options));
+  Print("periodic", RunPeriodic(options, false));
+  Print("skip", RunPeriodic(options, true));
+
+  return 0;
+}
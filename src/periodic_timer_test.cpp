@@ -0,0 +1,106 @@
+// Tests of utility::PeriodicTimer:
+//   - destroy the timer after Stop() while its aborted wait is still queued;
+//   - Stop() and Start() again while the tick of the previous run is already
+//     queued (too late to cancel): that stale tick must be ignored.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+#include "periodic_timer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define EXPECT(condition)                                             \
+  if (!(condition)) {                                                 \
+    std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition    \
+              << std::endl;                                           \
+    return false;                                                     \
+  }
+
+bool TestStopThenDestroy() {
+  boost::asio::io_context io_context;
+  bool called = false;
+
+  std::unique_ptr<utility::PeriodicTimer> timer(
+      new utility::PeriodicTimer(io_context, std::chrono::milliseconds(10)));
+  timer->Start([&called](std::size_t) { called = true; });
+  timer->Stop();
+  timer.reset();
+
+  // Runs the aborted handler of the destroyed timer.
+  io_context.run();
+
+  EXPECT(!called);
+  return true;
+}
+
+bool TestDestroyPending() {
+  bool called = false;
+
+  {
+    boost::asio::io_context io_context;
+
+    std::unique_ptr<utility::PeriodicTimer> timer(
+        new utility::PeriodicTimer(io_context, std::chrono::milliseconds(10)));
+    timer->Start([&called](std::size_t) { called = true; });
+    timer.reset();
+
+    io_context.run();
+  }
+
+  EXPECT(!called);
+  return true;
+}
+
+bool TestRestartIgnoresStaleTick() {
+  const Clock::duration period = std::chrono::milliseconds(100);
+
+  boost::asio::io_context io_context;
+  utility::PeriodicTimer timer(io_context, period);
+
+  Clock::time_point restarted;
+  Clock::time_point first_tick;
+
+  auto callback = [&](std::size_t) {
+    if (first_tick == Clock::time_point()) {
+      first_tick = Clock::now();
+    }
+    timer.Stop();
+  };
+
+  timer.Start(callback);
+
+  // Expires just before the tick. Once both have expired, they are queued
+  // together in the order of expiry, so the tick is already queued with
+  // success when this handler restarts the timer.
+  boost::asio::steady_timer restart(io_context);
+  restart.expires_at(timer.deadline() - std::chrono::milliseconds(1));
+  restart.async_wait([&](boost::system::error_code) {
+    timer.Stop();
+    restarted = Clock::now();
+    timer.Start(callback);
+  });
+
+  std::this_thread::sleep_for(period + std::chrono::milliseconds(20));
+  io_context.run();
+
+  EXPECT(first_tick != Clock::time_point());
+  EXPECT(first_tick - restarted >= period);
+  EXPECT(timer.ticks() == 1);
+  return true;
+}
+
+int main() {
+  bool ok = true;
+  ok = TestStopThenDestroy() && ok;
+  ok = TestDestroyPending() && ok;
+  ok = TestRestartIgnoresStaleTick() && ok;
+
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -1,7 +1,6 @@
 #include "daytime_client.h"
 
 #include <functional>
-#include <iostream>
 
 #include "boost/asio/connect.hpp"
 #include "boost/asio/read.hpp"
@@ -10,14 +9,11 @@
 using boost::asio::ip::tcp;
 
 DaytimeClient::DaytimeClient(boost::asio::io_context& io_context,
-                             const std::string& host)
-    : socket_(io_context), host_(host) {
+                             Callback callback)
+    : socket_(io_context), callback_(std::move(callback)) {
 }
 
-void DaytimeClient::Start() {
-  tcp::resolver resolver(socket_.get_executor().context());
-  auto endpoints = resolver.resolve(host_, "daytime");
-
+void DaytimeClient::Start(const tcp::resolver::results_type& endpoints) {
   // ConnectHandler: void(boost::system::error_code, tcp::endpoint)
   boost::asio::async_connect(socket_, endpoints,
                              std::bind(&DaytimeClient::OnConnect,
@@ -29,8 +25,8 @@ void DaytimeClient::Start() {
 void DaytimeClient::OnConnect(boost::system::error_code ec,
                               tcp::endpoint endpoint) {
   if (ec) {
-    std::cout << "Connect failed: " << ec.message() << std::endl;
     socket_.close();
+    callback_(ec, "");
   } else {
     DoRead();
   }
@@ -45,13 +41,11 @@ void DaytimeClient::DoRead() {
 }
 
 void DaytimeClient::OnRead(boost::system::error_code ec, std::size_t length) {
-  if (!ec) {
-    // This will not print anything except when launched from Linux termimal.
-    // If you want to display something in the GUI to indicate the status (a
-    // progress bar, maybe), remember this is executed in a separate thread,
-    // so you have to "notify" the GUI instead of call it directly. To notify
-    // the GUI, Qt's signal machanism should work.
-    std::cout.write(buf_.data(), length);
-    std::cout << std::endl;
+  // This is executed in the Asio thread, so the callback must not call the
+  // GUI directly; see DaytimeRequester for how the result gets to the GUI.
+  if (ec) {
+    callback_(ec, "");
+  } else {
+    callback_(ec, std::string(buf_.data(), length));
   }
 }
@@ -2,8 +2,11 @@
 #define DAYTIME_CLIENT_H_
 
 // Asynchronous daytime client.
+// The host is resolved by the caller, so that many clients of the same host
+// share one resolve.
 
 #include <array>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -13,10 +16,14 @@
 
 class DaytimeClient : public std::enable_shared_from_this<DaytimeClient> {
 public:
-  DaytimeClient(boost::asio::io_context& io_context,
-                const std::string& host);
+  // Called once with the daytime, or with the error.
+  typedef std::function<void(boost::system::error_code ec,
+                             const std::string& daytime)> Callback;
 
-  void Start();
+  DaytimeClient(boost::asio::io_context& io_context, Callback callback);
+
+  // Connect to one of the |endpoints| and read the daytime.
+  void Start(const boost::asio::ip::tcp::resolver::results_type& endpoints);
 
 private:
   void OnConnect(boost::system::error_code ec,
@@ -26,7 +33,7 @@ private:
   void OnRead(boost::system::error_code ec, std::size_t length);
 
   boost::asio::ip::tcp::socket socket_;
-  std::string host_;
+  Callback callback_;
 
   std::array<char, 512> buf_;
 };
@@ -0,0 +1,103 @@
+#include "daytime_requester.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+
+#include "boost/asio/post.hpp"
+
+#include "daytime_client.h"
+
+using boost::asio::ip::tcp;
+
+// The requests waiting for the Asio thread at most.
+static const std::size_t kMaxRequests = 4096;
+
+DaytimeRequester::DaytimeRequester(boost::asio::io_context& io_context,
+                                   QObject* parent)
+    : QObject(parent), io_context_(io_context), requests_(kMaxRequests),
+      drain_posted_(false) {
+}
+
+bool DaytimeRequester::Request(const std::string& host) {
+  std::string request = host;
+  if (!requests_.Push(std::move(request))) {
+    return false;
+  }
+
+  // Post a drain unless one is on the way; it will see this request, since
+  // it's cleared before the ring is drained.
+  if (!drain_posted_.exchange(true)) {
+    boost::asio::post(io_context_, [this]() { Drain(); });
+  }
+  return true;
+}
+
+std::vector<DaytimeResult> DaytimeRequester::TakeResults() {
+  return results_.Take();
+}
+
+void DaytimeRequester::Drain() {
+  // An exchange (not a store), to see the requests pushed before the last
+  // exchange in Request().
+  drain_posted_.exchange(false);
+
+  // Resolve each host once per drain, asynchronously, instead of once per
+  // request on this thread; a burst of thousands of requests would otherwise
+  // stall every client in flight behind as many synchronous lookups.
+  std::map<std::string, std::size_t> counts;
+  std::string host;
+  while (requests_.Pop(&host)) {
+    ++counts[host];
+  }
+
+  for (const auto& pair : counts) {
+    auto resolver = std::make_shared<tcp::resolver>(io_context_);
+    resolver->async_resolve(
+        pair.first, "daytime",
+        std::bind(&DaytimeRequester::OnResolve, this, resolver, pair.first,
+                  pair.second, std::placeholders::_1,
+                  std::placeholders::_2));
+  }
+}
+
+// The resolver is bound only to keep it alive until here.
+void DaytimeRequester::OnResolve(std::shared_ptr<tcp::resolver> /*resolver*/,
+                                 const std::string& host, std::size_t count,
+                                 boost::system::error_code ec,
+                                 tcp::resolver::results_type endpoints) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (ec) {
+      OnDaytime(host, ec, "");
+      continue;
+    }
+
+    auto client = std::make_shared<DaytimeClient>(
+        io_context_,
+        [this, host](boost::system::error_code ec,
+                     const std::string& daytime) {
+          OnDaytime(host, ec, daytime);
+        });
+    client->Start(endpoints);
+  }
+}
+
+void DaytimeRequester::OnDaytime(const std::string& host,
+                                 boost::system::error_code ec,
+                                 const std::string& daytime) {
+  DaytimeResult result;
+  result.host = host;
+  if (ec) {
+    result.error = ec.message();
+  } else {
+    result.daytime = daytime;
+  }
+  OnResult(std::move(result));
+}
+
+void DaytimeRequester::OnResult(DaytimeResult&& result) {
+  if (results_.Add(std::move(result))) {
+    // Queued to the GUI thread, since this object lives there.
+    emit ResultsReady();
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef DAYTIME_REQUESTER_H_
+#define DAYTIME_REQUESTER_H_
+
+// The channel between the GUI thread and the Asio thread.
+//   - GUI -> Asio: the requests go through a lock-free ring; only the first
+//     request since the Asio thread last drained the ring posts a handler to
+//     the io_context, which starts the clients of all the requests waiting,
+//     with one asynchronous resolve per host.
+//   - Asio -> GUI: the results are collected in a batch; only the first
+//     result of a batch emits ResultsReady() (a queued signal), and the GUI
+//     takes the whole batch with TakeResults().
+// So the cost per request on either thread doesn't grow with the rate of the
+// requests, and thousands of results per second cost the GUI one signal per
+// batch (see MyWindow for one batch per frame at most).
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QObject>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include "mpsc_ring.h"
+#include "result_batch.h"
+
+struct DaytimeResult {
+  std::string host;
+  std::string daytime;  // Empty on error
+  std::string error;
+};
+
+class DaytimeRequester : public QObject {
+  Q_OBJECT
+
+public:
+  DaytimeRequester(boost::asio::io_context& io_context,
+                   QObject* parent = nullptr);
+
+  // GUI thread. Return false if too many requests are waiting.
+  bool Request(const std::string& host);
+
+  // GUI thread. Take the results completed since the last call.
+  std::vector<DaytimeResult> TakeResults();
+
+signals:
+  // Emitted from the Asio thread for the first result of a batch; connect
+  // with Qt::QueuedConnection and call TakeResults().
+  void ResultsReady();
+
+private:
+  // Asio thread. Resolve the hosts of the requests waiting.
+  void Drain();
+
+  // Asio thread. Start the |count| clients of |host|.
+  void OnResolve(std::shared_ptr<boost::asio::ip::tcp::resolver> resolver,
+                 const std::string& host, std::size_t count,
+                 boost::system::error_code ec,
+                 boost::asio::ip::tcp::resolver::results_type endpoints);
+
+  // Asio thread.
+  void OnDaytime(const std::string& host, boost::system::error_code ec,
+                 const std::string& daytime);
+
+  // Asio thread.
+  void OnResult(DaytimeResult&& result);
+
+  boost::asio::io_context& io_context_;
+
+  MpscRing<std::string> requests_;
+
+  // If a Drain() has been posted and not started yet.
+  std::atomic<bool> drain_posted_;
+
+  ResultBatch<DaytimeResult> results_;
+};
+
+#endif  // DAYTIME_REQUESTER_H_
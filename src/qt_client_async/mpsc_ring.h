@@ -0,0 +1,97 @@
+#ifndef MPSC_RING_H_
+#define MPSC_RING_H_
+
+// A bounded lock-free queue for multiple producer threads and one consumer
+// thread, on a ring of cells each with a sequence number (D. Vyukov's bounded
+// MPMC queue, simplified for a single consumer).
+// Neither Push() nor Pop() blocks or allocates: Push() fails if the ring is
+// full, Pop() if it's empty.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class MpscRing {
+public:
+  // |capacity| is rounded up to a power of 2.
+  explicit MpscRing(std::size_t capacity)
+      : mask_(RoundUp(capacity) - 1), cells_(new Cell[mask_ + 1]), tail_(0),
+        head_(0) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  // Any thread.
+  bool Push(T&& value) {
+    Cell* cell = nullptr;
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      std::intptr_t diff = static_cast<std::intptr_t>(sequence) -
+                           static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        // The cell is free: claim it.
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Still taken by the value of the previous lap: full.
+        return false;
+      } else {
+        // Claimed by another producer meanwhile.
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // The consumer thread only.
+  bool Pop(T* value) {
+    Cell& cell = cells_[head_ & mask_];
+    std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence != head_ + 1) {
+      // Empty, or the producer of this cell hasn't finished yet.
+      return false;
+    }
+
+    *value = std::move(cell.value);
+    cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t RoundUp(std::size_t n) {
+    std::size_t size = 1;
+    while (size < n) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const std::size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // Apart, so that the producers and the consumer don't share a cache line.
+  alignas(64) std::atomic<std::size_t> tail_;
+  alignas(64) std::size_t head_;
+};
+
+#endif  // MPSC_RING_H_
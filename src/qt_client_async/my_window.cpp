@@ -1,30 +1,58 @@
 #include "my_window.h"
 
-#include <functional>
-#include <memory>
-#include <thread>
+#include <string>
+#include <vector>
 
+#include <QLabel>
+#include <QPlainTextEdit>
 #include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
 
-#include "daytime_client.h"
+#include "daytime_requester.h"
 
 static const std::string kHost = "time.nist.gov";
 
+// Drain the results at most once per frame (60 FPS).
+static const qint64 kFrameMs = 16;
+
+// Show at most this many results per drain; the rest are only counted.
+static const std::size_t kMaxShownResults = 10;
+
 MyWindow::MyWindow(boost::asio::io_context& io_context)
-    : io_context_(io_context) {
+    : drain_scheduled_(false), requested_(0), dropped_(0), succeeded_(0),
+      failed_(0) {
   setWindowTitle(tr("Qt Asio Example"));
 
+  // Owned by this window, so it lives in the GUI thread and its signal
+  // (emitted from the Asio thread) is queued.
+  requester_ = new DaytimeRequester(io_context, this);
+
   QWidget* central_widget = new QWidget();
   setCentralWidget(central_widget);
 
   button_ = new QPushButton(tr("Get Daytime"));
   button_->setToolTip(QStringLiteral("Use Asio to get current daytime"));
 
+  count_spin_box_ = new QSpinBox();
+  count_spin_box_->setRange(1, 10000);
+  count_spin_box_->setToolTip(QStringLiteral("Requests per click"));
+
+  status_label_ = new QLabel();
+
+  results_edit_ = new QPlainTextEdit();
+  results_edit_->setReadOnly(true);
+  // Keep appending cheap however many results there have been.
+  results_edit_->setMaximumBlockCount(1000);
+
   QVBoxLayout* vlayout = new QVBoxLayout();
 
   vlayout->addWidget(button_, 0, Qt::AlignCenter);
+  vlayout->addWidget(count_spin_box_, 0, Qt::AlignCenter);
+  vlayout->addWidget(status_label_);
+  vlayout->addWidget(results_edit_);
 
   central_widget->setLayout(vlayout);
 
@@ -32,18 +60,87 @@ MyWindow::MyWindow(boost::asio::io_context& io_context)
 
   QObject::connect(button_, &QPushButton::clicked,
                    this, &MyWindow::GetDaytime);
+
+  QObject::connect(requester_, &DaytimeRequester::ResultsReady,
+                   this, &MyWindow::OnResultsReady, Qt::QueuedConnection);
+
+  UpdateStatus();
 }
 
 void MyWindow::GetDaytime() {
-  // Use std::shared_ptr to ensure the life of DaytimeClient.
-  auto client = std::make_shared<DaytimeClient>(io_context_, kHost);
-
-  // Don't execute Start() from the GUI thread because it consists of
+  // Don't start the clients from the GUI thread because they consist of
   // async operations which should be run in the same thread as io_context.
-  // Use post() instead.
-  // Note that the lambda function posted doesn't rely on MyWindow at all.
-  // The |client| variable is copied so the reference count is increased.
-  boost::asio::post(io_context_, [client]() {
-    client->Start();
-  });
+  // The requester hands the requests over to the Asio thread instead.
+  int count = count_spin_box_->value();
+  for (int i = 0; i < count; ++i) {
+    ++requested_;
+    if (!requester_->Request(kHost)) {
+      ++dropped_;
+    }
+  }
+
+  UpdateStatus();
+}
+
+void MyWindow::OnResultsReady() {
+  if (drain_scheduled_) {
+    return;
+  }
+
+  qint64 elapsed = drain_timer_.isValid() ? drain_timer_.elapsed() : kFrameMs;
+  if (elapsed >= kFrameMs) {
+    DrainResults();
+  } else {
+    // The results completed meanwhile join the batch.
+    drain_scheduled_ = true;
+    QTimer::singleShot(static_cast<int>(kFrameMs - elapsed), this,
+                       &MyWindow::DrainResults);
+  }
+}
+
+void MyWindow::DrainResults() {
+  drain_scheduled_ = false;
+  drain_timer_.start();
+
+  std::vector<DaytimeResult> results = requester_->TakeResults();
+  if (results.empty()) {
+    return;
+  }
+
+  // One append per batch, of the last few results.
+  QString text;
+  std::size_t first = results.size() > kMaxShownResults
+                          ? results.size() - kMaxShownResults
+                          : 0;
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const DaytimeResult& result = results[i];
+    if (result.error.empty()) {
+      ++succeeded_;
+    } else {
+      ++failed_;
+    }
+
+    if (i >= first) {
+      if (!text.isEmpty()) {
+        text += '\n';
+      }
+      text += QString::fromStdString(result.host) + ": " +
+              QString::fromStdString(result.error.empty()
+                                         ? result.daytime
+                                         : "Error: " + result.error)
+                  .trimmed();
+    }
+  }
+  results_edit_->appendPlainText(text);
+
+  UpdateStatus();
+}
+
+void MyWindow::UpdateStatus() {
+  status_label_->setText(tr("Requested: %1, dropped: %2, succeeded: %3, "
+                            "failed: %4")
+                             .arg(requested_)
+                             .arg(dropped_)
+                             .arg(succeeded_)
+                             .arg(failed_));
 }
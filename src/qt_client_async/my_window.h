@@ -1,11 +1,19 @@
 #ifndef MY_WINDOW_H_
 #define MY_WINDOW_H_
 
+#include <cstddef>
+
+#include <QElapsedTimer>
 #include <QMainWindow>
 
 #include "boost/asio/io_context.hpp"
 
+QT_FORWARD_DECLARE_CLASS(QLabel)
+QT_FORWARD_DECLARE_CLASS(QPlainTextEdit)
 QT_FORWARD_DECLARE_CLASS(QPushButton)
+QT_FORWARD_DECLARE_CLASS(QSpinBox)
+
+class DaytimeRequester;
 
 class MyWindow : public QMainWindow {
   Q_OBJECT
@@ -16,10 +24,29 @@ public:
 private slots:
   void GetDaytime();
 
+  // A batch of results is ready; drain it now or at the next frame.
+  void OnResultsReady();
+
+  void DrainResults();
+
 private:
-  boost::asio::io_context& io_context_;
+  void UpdateStatus();
+
+  DaytimeRequester* requester_;
 
   QPushButton* button_;
+  QSpinBox* count_spin_box_;
+  QLabel* status_label_;
+  QPlainTextEdit* results_edit_;
+
+  // Since the last drain of the results.
+  QElapsedTimer drain_timer_;
+  bool drain_scheduled_;
+
+  std::size_t requested_;
+  std::size_t dropped_;
+  std::size_t succeeded_;
+  std::size_t failed_;
 };
 
 #endif  // MY_WINDOW_H_
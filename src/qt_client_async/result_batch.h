@@ -0,0 +1,36 @@
+#ifndef RESULT_BATCH_H_
+#define RESULT_BATCH_H_
+
+// Results handed over from one thread to another in batches.
+// Add() tells when a batch starts, i.e., when the other thread should be
+// notified; the results added until it calls Take() join the same batch, so
+// there's one notification per batch instead of one per result.
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class ResultBatch {
+public:
+  // Return true for the first result of a batch.
+  bool Add(T&& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_.push_back(std::move(result));
+    return results_.size() == 1;
+  }
+
+  // Take the whole batch.
+  std::vector<T> Take() {
+    std::vector<T> batch;
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch.swap(results_);
+    return batch;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<T> results_;
+};
+
+#endif  // RESULT_BATCH_H_
@@ -1,132 +1,411 @@
+// TLS echo load generator, e.g., for |ssl_server|.
+// N connections each send a payload of the given size and read it back, one
+// echo at a time, for the given duration. Reported are:
+//   - handshakes/sec, full and resumed, and the handshake latency,
+//   - echo latency percentiles, i.e., from writing the payload to having read
+//     all of it back,
+//   - echo throughput.
+// With --churn=R, R connections per second are closed after their current
+// echo and connected again, so that the handshakes are loaded, too. With
+// --resume, such a reconnection resumes the previous TLS session of the
+// connection (session ticket or session ID); otherwise it's a full handshake.
+// The server certificate is verified with the bundled ca.pem (--ca).
+// E.g.,
+//   $ ssl_server 8443 --stats
+//   $ ssl_client localhost 8443 --connections=100 --churn=50 --resume
+
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
-#define BOOST_ASIO_NO_DEPRECATED
 #include "boost/asio.hpp"
 #include "boost/asio/ssl.hpp"
 
+#include "utility.h"
+
 using boost::asio::ip::tcp;
 namespace ssl = boost::asio::ssl;
 
+typedef ssl::stream<tcp::socket> ssl_socket;
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+struct Stats {
+  std::size_t connects = 0;
+  std::size_t handshakes = 0;
+  std::size_t resumed = 0;
+  std::size_t errors = 0;
+
+  std::size_t echoes = 0;
+  std::size_t bytes = 0;  // Payload bytes echoed
+
+  std::vector<double> handshake_latencies;  // Milliseconds
+  std::vector<double> echo_latencies;       // Microseconds
+};
+
 // -----------------------------------------------------------------------------
 
-class Client {
+class Connection {
 public:
-  Client(boost::asio::io_context& io_context,
-         ssl::context& ssl_context,
-         tcp::resolver::results_type endpoints)
-      : socket_(io_context, ssl_context) {
-    socket_.set_verify_mode(ssl::verify_peer);
-
-    socket_.set_verify_callback(std::bind(&Client::VerifyCertificate, this,
-                                          std::placeholders::_1,
-                                          std::placeholders::_2));
-
-    boost::asio::async_connect(socket_.lowest_layer(), endpoints,
-                               std::bind(&Client::HandleConnect, this,
-                                         std::placeholders::_1));
+  Connection(boost::asio::io_context& io_context, ssl::context& ssl_context,
+             const tcp::resolver::results_type& endpoints,
+             const std::string& host, std::size_t payload_size, bool resume,
+             Stats& stats)
+      : io_context_(io_context), ssl_context_(ssl_context),
+        endpoints_(endpoints), host_(host),
+        request_(payload_size, 'x'), reply_(payload_size),
+        resume_(resume), session_(nullptr), session_saved_(false),
+        reconnect_(false), retry_timer_(io_context), stats_(stats) {
+  }
+
+  ~Connection() {
+    if (session_ != nullptr) {
+      SSL_SESSION_free(session_);
+    }
+  }
+
+  void Start() {
+    Connect();
+  }
+
+  // Close and connect again after the current echo.
+  void Reconnect() {
+    reconnect_ = true;
   }
 
-  bool VerifyCertificate(bool preverified, ssl::verify_context& ctx) {
-    // The verify callback can be used to check whether the certificate that is
-    // being presented is valid for the peer. For example, RFC 2818 describes
-    // the steps involved in doing this for HTTPS. Consult the OpenSSL
-    // documentation for more details. Note that the callback is called once
-    // for each certificate in the certificate chain, starting from the root
-    // certificate authority.
+private:
+  void Connect() {
+    socket_.reset(new ssl_socket(io_context_, ssl_context_));
+
+#if BOOST_VERSION < 107300
+    socket_->set_verify_callback(ssl::rfc2818_verification(host_));
+#else
+    socket_->set_verify_callback(ssl::host_name_verification(host_));
+#endif  // BOOST_VERSION < 107300
+
+    if (resume_ && session_ != nullptr) {
+      SSL_set_session(socket_->native_handle(), session_);
+    }
+    session_saved_ = false;
 
-    // In this example we will simply print the certificate's subject name.
-    char subject_name[256];
-    X509* cert = X509_STORE_CTX_get_current_cert(ctx.native_handle());
-    X509_NAME_oneline(X509_get_subject_name(cert), subject_name, 256);
-    std::cout << "Verifying " << subject_name << "\n";
+    ++stats_.connects;
+    connect_time_ = Clock::now();
 
-    return preverified;
+    boost::asio::async_connect(socket_->lowest_layer(), endpoints_,
+                               std::bind(&Connection::HandleConnect, this,
+                                         std::placeholders::_1));
   }
 
   void HandleConnect(boost::system::error_code ec) {
-    if (!ec) {
-      socket_.async_handshake(ssl::stream_base::client,
-                              std::bind(&Client::HandleHandshake, this,
-                                        std::placeholders::_1));
-    } else {
-      std::cout << "Connect failed: " << ec.message() << "\n";
+    if (ec) {
+      Fail();
+      return;
     }
+
+    socket_->lowest_layer().set_option(tcp::no_delay(true), ec);
+    if (ec) {
+      Fail();
+      return;
+    }
+
+    socket_->async_handshake(ssl::stream_base::client,
+                             std::bind(&Connection::HandleHandshake, this,
+                                       std::placeholders::_1));
   }
 
   void HandleHandshake(boost::system::error_code ec) {
-    if (!ec) {
-      std::cout << "Enter message: ";
-      std::cin.getline(request_, kMaxLength);
-      size_t request_length = strlen(request_);
-
-      boost::asio::async_write(socket_,
-                               boost::asio::buffer(request_, request_length),
-                               std::bind(&Client::HandleWrite, this,
-                                         std::placeholders::_1,
-                                         std::placeholders::_2));
-    } else {
-      std::cout << "Handshake failed: " << ec.message() << "\n";
+    if (ec) {
+      Fail();
+      return;
+    }
+
+    ++stats_.handshakes;
+    if (SSL_session_reused(socket_->native_handle())) {
+      ++stats_.resumed;
     }
+
+    std::chrono::duration<double, std::milli> latency =
+        Clock::now() - connect_time_;
+    stats_.handshake_latencies.push_back(latency.count());
+
+    DoEcho();
   }
 
-  void HandleWrite(boost::system::error_code ec, size_t length) {
-    if (!ec) {
-      boost::asio::async_read(socket_,
-                              boost::asio::buffer(reply_, length),
-                              std::bind(&Client::HandleRead, this,
-                                        std::placeholders::_1,
-                                        std::placeholders::_2));
-    } else {
-      std::cout << "Write failed: " << ec.message() << "\n";
+  void DoEcho() {
+    echo_time_ = Clock::now();
+
+    boost::asio::async_write(*socket_, boost::asio::buffer(request_),
+                             std::bind(&Connection::HandleWrite, this,
+                                       std::placeholders::_1,
+                                       std::placeholders::_2));
+  }
+
+  void HandleWrite(boost::system::error_code ec, std::size_t length) {
+    if (ec) {
+      Fail();
+      return;
     }
+
+    boost::asio::async_read(*socket_, boost::asio::buffer(reply_),
+                            std::bind(&Connection::HandleRead, this,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2));
   }
 
-  void HandleRead(boost::system::error_code ec, size_t length) {
-    if (!ec) {
-      std::cout << "Reply: ";
-      std::cout.write(reply_, length);
-      std::cout << "\n";
+  void HandleRead(boost::system::error_code ec, std::size_t length) {
+    if (ec) {
+      Fail();
+      return;
+    }
+
+    std::chrono::duration<double, std::micro> latency =
+        Clock::now() - echo_time_;
+    stats_.echo_latencies.push_back(latency.count());
+    ++stats_.echoes;
+    stats_.bytes += length;
+
+    // With TLS 1.3 the session (ticket) arrives after the handshake, so it's
+    // only available after the first read.
+    if (resume_ && !session_saved_) {
+      if (session_ != nullptr) {
+        SSL_SESSION_free(session_);
+      }
+      session_ = SSL_get1_session(socket_->native_handle());
+      session_saved_ = true;
+    }
+
+    if (reconnect_) {
+      reconnect_ = false;
+      Close();
+      Connect();
     } else {
-      std::cout << "Read failed: " << ec.message() << "\n";
+      DoEcho();
     }
   }
 
+  void Close() {
+    // Mark the connection as shut down, otherwise OpenSSL considers the
+    // session broken and won't resume it. The server doesn't care about a
+    // close_notify, so it's not sent.
+    SSL_set_shutdown(socket_->native_handle(),
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+
+    boost::system::error_code ec;
+    socket_->lowest_layer().close(ec);
+  }
+
+  // Count the error and connect again a bit later.
+  void Fail() {
+    ++stats_.errors;
+
+    boost::system::error_code ec;
+    socket_->lowest_layer().close(ec);
+
+    retry_timer_.expires_after(std::chrono::milliseconds(100));
+    retry_timer_.async_wait([this](boost::system::error_code ec) {
+      if (!ec) {
+        Connect();
+      }
+    });
+  }
+
+  boost::asio::io_context& io_context_;
+  ssl::context& ssl_context_;
+  tcp::resolver::results_type endpoints_;
+  std::string host_;
+
+  // A new stream for each connection; an SSL stream can't be reused.
+  std::unique_ptr<ssl_socket> socket_;
+
+  std::vector<char> request_;
+  std::vector<char> reply_;
+
+  bool resume_;
+  SSL_SESSION* session_;  // The session to resume
+  bool session_saved_;
+
+  bool reconnect_;
+
+  Clock::time_point connect_time_;
+  Clock::time_point echo_time_;
+
+  boost::asio::steady_timer retry_timer_;
+
+  Stats& stats_;
+};
+
+// -----------------------------------------------------------------------------
+
+// Ask the connections, one by one, to reconnect at the given rate.
+class Churner {
+public:
+  Churner(boost::asio::io_context& io_context,
+          std::vector<std::unique_ptr<Connection>>& connections, double rate)
+      : timer_(io_context), connections_(connections), next_(0),
+        interval_(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / rate))) {
+    deadline_ = Clock::now();
+    Schedule();
+  }
+
 private:
-  ssl::stream<tcp::socket> socket_;
+  void Schedule() {
+    // Rearm from the deadline, not from now, to keep the rate.
+    deadline_ += interval_;
+    timer_.expires_at(deadline_);
+    timer_.async_wait(std::bind(&Churner::HandleTimer, this,
+                                std::placeholders::_1));
+  }
 
-  enum { kMaxLength = 1024 };
-  char request_[kMaxLength];
-  char reply_[kMaxLength];
+  void HandleTimer(boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+
+    connections_[next_++ % connections_.size()]->Reconnect();
+    Schedule();
+  }
+
+  boost::asio::steady_timer timer_;
+  std::vector<std::unique_ptr<Connection>>& connections_;
+  std::size_t next_;
+  Clock::duration interval_;
+  Clock::time_point deadline_;
 };
 
 // -----------------------------------------------------------------------------
 
+void PrintPercentiles(std::vector<double>& samples, const char* unit) {
+  std::sort(samples.begin(), samples.end());
+  std::cout << "p50 " << utility::Percentile(samples, 0.5)
+            << ", p90 " << utility::Percentile(samples, 0.9)
+            << ", p99 " << utility::Percentile(samples, 0.99)
+            << ", max " << (samples.empty() ? 0.0 : samples.back())
+            << " " << unit << std::endl;
+}
+
+void PrintReport(Stats& stats, double seconds, double cpu_seconds) {
+  std::cout << std::fixed << std::setprecision(1);
+
+  std::cout << "handshakes: " << stats.handshakes
+            << " (" << stats.handshakes / seconds << "/s)"
+            << ", resumed: " << stats.resumed
+            << ", full: " << stats.handshakes - stats.resumed
+            << ", errors: " << stats.errors << std::endl;
+
+  std::cout << "handshake latency: ";
+  PrintPercentiles(stats.handshake_latencies, "ms");
+
+  std::cout << "echo latency: ";
+  PrintPercentiles(stats.echo_latencies, "us");
+
+  std::cout << "echoes/s: " << stats.echoes / seconds
+            << ", throughput: " << stats.bytes / seconds / 1e6 << " MB/s"
+            << " (each way)"
+            << ", CPU: " << cpu_seconds / seconds * 100 << "%" << std::endl;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <host> <port> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --connections=<n>  Default: 10" << std::endl;
+  std::cout << "    --churn=<n>        Reconnections per second. Default: 0"
+            << std::endl;
+  std::cout << "    --resume           Resume the TLS session on reconnection."
+            << std::endl;
+  std::cout << "    --payload=<n>      Bytes per echo. Default: 64"
+            << std::endl;
+  std::cout << "    --duration=<n>     Seconds. Default: 10" << std::endl;
+  std::cout << "    --ca=<file>        Default: the bundled ca.pem" << std::endl;
+  std::cout << "  E.g.," << std::endl;
+  std::cout << "    " << argv0
+            << " localhost 8443 --connections=100 --churn=50 --resume"
+            << std::endl;
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <host> <port>" << std::endl;
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::string host = options.args()[0];
+  std::string port = options.args()[1];
+
+  std::size_t connection_count = options.GetInt("connections", 10);
+  double churn = options.GetDouble("churn", 0.0);
+  bool resume = options.Has("resume");
+  std::size_t payload_size = options.GetInt("payload", 64);
+  double duration = options.GetDouble("duration", 10.0);
+  std::string ca_file = options.Get("ca", std::string(SSL_CERT_DIR) + "ca.pem");
+
+  if (connection_count == 0 || payload_size == 0 || duration <= 0) {
+    Help(argv[0]);
     return 1;
   }
 
   try {
-    boost::asio::io_context io_context;
+    boost::asio::io_context io_context(1);
 
     tcp::resolver resolver(io_context);
-    auto endpoints = resolver.resolve(argv[1], argv[2]);
+    auto endpoints = resolver.resolve(host, port);
 
     ssl::context ssl_context(ssl::context::sslv23);
+    ssl_context.load_verify_file(ca_file);
+    ssl_context.set_verify_mode(ssl::verify_peer);
+
+    Stats stats;
 
-    // Use the default paths for finding CA certificates.
-    //ssl_context.set_default_verify_paths();
-    // TODO
-    ssl_context.load_verify_file("D:\\github\\boost-asio-study\\src\\ssl\\ca.pem");
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (std::size_t i = 0; i < connection_count; ++i) {
+      connections.emplace_back(new Connection(io_context, ssl_context,
+                                              endpoints, host, payload_size,
+                                              resume, stats));
+      connections.back()->Start();
+    }
+
+    std::unique_ptr<Churner> churner;
+    if (churn > 0) {
+      churner.reset(new Churner(io_context, connections, churn));
+    }
 
-    Client client(io_context, ssl_context, endpoints);
+    // Stop everything when the time is up; the pending operations are just
+    // abandoned.
+    boost::asio::steady_timer stop_timer(io_context);
+    stop_timer.expires_after(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(duration)));
+    stop_timer.async_wait([&io_context](boost::system::error_code) {
+      io_context.stop();
+    });
+
+    double cpu_seconds = utility::GetCpuSeconds();
+    Clock::time_point start = Clock::now();
 
     io_context.run();
 
+    std::chrono::duration<double> seconds = Clock::now() - start;
+    cpu_seconds = utility::GetCpuSeconds() - cpu_seconds;
+
+    std::cout << "connections: " << connection_count
+              << ", churn: " << churn << "/s"
+              << ", resume: " << (resume ? "yes" : "no")
+              << ", payload: " << payload_size << " bytes" << std::endl;
+
+    PrintReport(stats, seconds.count(), cpu_seconds);
+
   } catch (const std::exception& e) {
-    std::cerr << "Exception: " << e.what() << "\n";
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
   }
 
   return 0;
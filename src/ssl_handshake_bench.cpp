@@ -0,0 +1,248 @@
+// TLS handshake microbenchmark over loopback.
+// For each TLS profile (see utility::ApplyTlsProfile()), full handshakes are
+// run between a client and a server in the same process, on one thread, i.e.,
+// one core doing both sides. Session resumption is disabled so that every
+// handshake is a full one.
+// E.g.,
+//   $ ssl_handshake_bench --count=2000 --profiles=compat,ecdhe,tls13
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ssl.hpp"
+
+#include "tls_utility.h"
+#include "utility.h"
+
+using boost::asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+
+typedef ssl::stream<tcp::socket> ssl_socket;
+
+// -----------------------------------------------------------------------------
+
+class HandshakeBench {
+public:
+  HandshakeBench(const std::string& profile, const std::string& cert_dir,
+                 std::size_t count, std::size_t concurrency);
+
+  void Run();
+
+  std::size_t completed() const { return completed_; }
+  std::size_t failed() const { return failed_; }
+  const std::string& description() const { return description_; }
+
+private:
+  void DoAccept();
+
+  void DoConnect();
+  void OnClientHandshake(std::shared_ptr<ssl_socket> socket,
+                         boost::system::error_code ec);
+
+  boost::asio::io_context io_context_;
+
+  ssl::context server_context_;
+  ssl::context client_context_;
+
+  tcp::acceptor acceptor_;
+  tcp::endpoint endpoint_;
+
+  std::size_t count_;
+  std::size_t concurrency_;
+
+  std::size_t started_;
+  std::size_t completed_;
+  std::size_t failed_;
+
+  // The negotiated version, cipher and group.
+  std::string description_;
+};
+
+HandshakeBench::HandshakeBench(const std::string& profile,
+                               const std::string& cert_dir,
+                               std::size_t count, std::size_t concurrency)
+    : io_context_(1),
+      server_context_(ssl::context::sslv23),
+      client_context_(ssl::context::sslv23),
+      acceptor_(io_context_,
+                tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+      count_(count), concurrency_(concurrency),
+      started_(0), completed_(0), failed_(0) {
+  server_context_.set_options(ssl::context::default_workarounds |
+                              ssl::context::no_sslv2 |
+                              ssl::context::single_dh_use);
+  server_context_.set_password_callback(
+      [](std::size_t, ssl::context::password_purpose) {
+        return std::string("test");
+      });
+  server_context_.use_certificate_chain_file(cert_dir + "server.pem");
+  server_context_.use_private_key_file(cert_dir + "server.pem",
+                                       ssl::context::pem);
+
+  utility::ApplyTlsProfile(server_context_, profile, cert_dir + "dh2048.pem");
+  utility::DisableSessionResumption(server_context_);
+
+  // The client accepts whatever the server offers, like a browser would.
+  client_context_.set_verify_mode(ssl::verify_none);
+  utility::DisableSessionResumption(client_context_);
+
+  endpoint_ = acceptor_.local_endpoint();
+}
+
+void HandshakeBench::Run() {
+  DoAccept();
+
+  for (std::size_t i = 0; i < concurrency_; ++i) {
+    DoConnect();
+  }
+
+  io_context_.run();
+}
+
+void HandshakeBench::DoAccept() {
+  acceptor_.async_accept([this](boost::system::error_code ec,
+                                tcp::socket socket) {
+    if (ec) {
+      return;
+    }
+
+    auto server_socket =
+        std::make_shared<ssl_socket>(std::move(socket), server_context_);
+
+    // The server side is done with the handshake; the client closes.
+    server_socket->async_handshake(
+        ssl::stream_base::server,
+        [server_socket](boost::system::error_code) {});
+
+    DoAccept();
+  });
+}
+
+void HandshakeBench::DoConnect() {
+  if (started_ >= count_) {
+    if (completed_ + failed_ >= count_) {
+      acceptor_.close();
+    }
+    return;
+  }
+
+  ++started_;
+
+  auto socket = std::make_shared<ssl_socket>(io_context_, client_context_);
+
+  socket->lowest_layer().async_connect(
+      endpoint_, [this, socket](boost::system::error_code ec) {
+        if (ec) {
+          OnClientHandshake(socket, ec);
+          return;
+        }
+        socket->async_handshake(ssl::stream_base::client,
+                                std::bind(&HandshakeBench::OnClientHandshake,
+                                          this, socket,
+                                          std::placeholders::_1));
+      });
+}
+
+void HandshakeBench::OnClientHandshake(std::shared_ptr<ssl_socket> socket,
+                                       boost::system::error_code ec) {
+  if (ec) {
+    ++failed_;
+  } else {
+    ++completed_;
+    if (description_.empty()) {
+      description_ = utility::DescribeTlsConnection(socket->native_handle());
+    }
+  }
+
+  boost::system::error_code ignored_ec;
+  socket->lowest_layer().close(ignored_ec);
+
+  DoConnect();
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::string> Split(const std::string& str, char delimiter) {
+  std::vector<std::string> parts;
+  std::istringstream iss(str);
+  std::string part;
+  while (std::getline(iss, part, delimiter)) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --count=<n>           Handshakes per profile. Default: 1000"
+            << std::endl;
+  std::cout << "    --concurrency=<n>     Handshakes in flight. Default: 4"
+            << std::endl;
+  std::cout << "    --profiles=<a,b,...>  Default: all" << std::endl;
+  std::cout << "    --cert-dir=<dir>      Directory of server.pem, etc."
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::size_t count = options.GetInt("count", 1000);
+  std::size_t concurrency = options.GetInt("concurrency", 4);
+  std::string cert_dir = options.Get("cert-dir", SSL_CERT_DIR);
+
+  std::vector<std::string> profiles = utility::GetTlsProfiles();
+  if (options.Has("profiles")) {
+    profiles = Split(options.Get("profiles"), ',');
+  }
+
+  std::cout << std::left << std::setw(8) << "profile" << std::right
+            << std::setw(14) << "handshakes/s" << std::setw(12) << "CPU us"
+            << std::setw(8) << "failed" << "  negotiated" << std::endl;
+
+  for (const std::string& profile : profiles) {
+    try {
+      HandshakeBench bench(profile, cert_dir, count, concurrency);
+
+      double cpu_before = utility::GetCpuSeconds();
+      auto start = std::chrono::steady_clock::now();
+
+      bench.Run();
+
+      double seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      double cpu = utility::GetCpuSeconds() - cpu_before;
+
+      // One thread does both sides; per core is per CPU second.
+      std::size_t completed = bench.completed();
+
+      std::cout << std::left << std::setw(8) << profile << std::right
+                << std::fixed << std::setprecision(1)
+                << std::setw(14) << (cpu > 0 ? completed / cpu
+                                             : completed / seconds)
+                << std::setw(12)
+                << (completed > 0 ? cpu * 1e6 / completed : 0.0)
+                << std::setw(8) << bench.failed()
+                << "  " << bench.description() << std::endl;
+
+    } catch (const std::exception& e) {
+      std::cerr << profile << ": " << e.what() << std::endl;
+    }
+  }
+
+  return 0;
+}
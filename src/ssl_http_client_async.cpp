@@ -1,13 +1,28 @@
 // HTTPs client sending a GET request.
 // Based on Asio asynchronous APIs.
-
+// With --gzip, "Accept-Encoding: gzip, deflate" is sent and the response body
+// is inflated chunk by chunk as it arrives.
+// ALPN offers "http/1.1". With --repeat=N, the request is sent N times, each
+// on a new connection resuming the TLS session of the previous one. With
+// --early-data, a resumed TLS 1.3 connection sends the request as early data
+// (0-RTT) when the session allows it; if the server rejects it, the request
+// is sent again after the handshake. This is only for idempotent requests
+// like this GET: early data can be replayed.
+// The time to first byte (TTFB) includes the connect and the handshake.
+
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "boost/asio.hpp"
 #include "boost/asio/ssl.hpp"
 
+#include "http_response_decoder.h"
+#include "tls_utility.h"
+#include "utility.h"
+
 // -----------------------------------------------------------------------------
 
 using boost::asio::ip::tcp;
@@ -22,12 +37,35 @@ typedef ssl::stream<tcp::socket> ssl_socket;
 
 class Client {
 public:
-  Client(boost::asio::io_context& io_context,
-         const std::string& host, const std::string& path);
+  // |session|: the TLS session to resume, or null.
+  // |early_data|: send the request as early data if |session| allows.
+  Client(boost::asio::io_context& io_context, ssl::context& ssl_context,
+         const std::string& host, const std::string& path,
+         const std::string& port, bool accept_encoding,
+         SSL_SESSION* session, bool early_data);
+
+  const utility::HttpResponseDecoder& decoder() const { return decoder_; }
+
+  SSL* ssl() { return ssl_socket_.native_handle(); }
+
+  // "accepted", "rejected" or "not sent".
+  const char* early_data_status() const { return early_data_status_; }
+
+  // From the start of the connect to the first byte of the response.
+  std::chrono::steady_clock::duration ttfb() const { return ttfb_; }
+
+  // The session for the next connection to resume; free it with
+  // SSL_SESSION_free(). Call it after the response.
+  SSL_SESSION* GetSession();
 
 private:
   void ConnectHandler(boost::system::error_code ec, tcp::endpoint);
 
+  bool CanSendEarlyData() const;
+  void WriteEarlyData();
+  void EarlyDataWaitHandler(boost::system::error_code ec);
+
+  void AsyncHandshake();
   void HandshakeHandler(boost::system::error_code ec);
 
   void AsyncWrite();
@@ -36,36 +74,70 @@ private:
   void AsyncReadSome();
   void ReadHandler(boost::system::error_code ec, std::size_t length);
 
+  void OnBody(const char* data, std::size_t size);
+
   boost::asio::io_context& io_context_;
 
   std::string host_;
   std::string path_;
 
-  ssl::context ssl_context_;
+  // Send "Accept-Encoding: gzip, deflate" or not.
+  bool accept_encoding_;
+
   ssl::stream<tcp::socket> ssl_socket_;
 
+  SSL_SESSION* session_;
+
+  bool early_data_;
+  std::unique_ptr<utility::DirectSocketIo> direct_io_;
+  std::size_t early_data_written_;
+  bool early_data_sent_;
+  const char* early_data_status_;
+
   boost::asio::streambuf request_;
   std::vector<char> buffer_;
+
+  utility::HttpResponseDecoder decoder_;
+
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::duration ttfb_;
 };
 
 // -----------------------------------------------------------------------------
 
-Client::Client(boost::asio::io_context& io_context,
-               const std::string& host, const std::string& path)
+Client::Client(boost::asio::io_context& io_context, ssl::context& ssl_context,
+               const std::string& host, const std::string& path,
+               const std::string& port, bool accept_encoding,
+               SSL_SESSION* session, bool early_data)
     : io_context_(io_context),
       host_(host), path_(path),
-      ssl_context_(ssl::context::sslv23),
-      ssl_socket_(io_context_, ssl_context_),
-      buffer_(1024) {
-
-  // Use the default paths for finding CA certificates.
-  ssl_context_.set_default_verify_paths();
+      accept_encoding_(accept_encoding),
+      ssl_socket_(io_context_, ssl_context),
+      session_(session),
+      early_data_(early_data),
+      early_data_written_(0),
+      early_data_sent_(false),
+      early_data_status_("not sent"),
+      buffer_(16 * 1024),
+      decoder_(std::bind(&Client::OnBody, this, std::placeholders::_1,
+                         std::placeholders::_2)),
+      start_(std::chrono::steady_clock::now()),
+      ttfb_(0) {
+
+  // The request is built beforehand, it might go out as early data.
+  std::ostream request_stream(&request_);
+  request_stream << "GET " << path_ << " HTTP/1.1\r\n";
+  request_stream << "Host: " << host_ << "\r\n";
+  if (accept_encoding_) {
+    request_stream << "Accept-Encoding: gzip, deflate\r\n";
+  }
+  request_stream << "\r\n";
 
   boost::system::error_code ec;
 
   // Get a list of endpoints corresponding to the server name.
   tcp::resolver resolver(io_context_);
-  auto endpoints = resolver.resolve(host_, "https", ec);
+  auto endpoints = resolver.resolve(host_, port, ec);
 
   if (ec) {
     std::cerr << "Resolve failed: " << ec.message() << std::endl;
@@ -97,28 +169,112 @@ void Client::ConnectHandler(boost::system::error_code ec, tcp::endpoint) {
     ssl_socket_.set_verify_callback(ssl::host_name_verification(host_));
 #endif  // BOOST_VERSION < 107300
 
-    // HandshakeHandler: void (boost::system::error_code)
-    ssl_socket_.async_handshake(ssl::stream_base::client,
-                                std::bind(&Client::HandshakeHandler,
-                                this,
-                                std::placeholders::_1));
+    SSL* ssl = ssl_socket_.native_handle();
+
+    // SNI. A session is only resumed for the same server name.
+    SSL_set_tlsext_host_name(ssl, host_.c_str());
+
+    static const std::string kAlpnProtocols =
+        utility::EncodeAlpnProtocols({ "http/1.1" });
+    utility::SetAlpnProtocols(ssl, kAlpnProtocols);
+
+    if (session_ != nullptr) {
+      SSL_set_session(ssl, session_);
+    }
+
+    if (CanSendEarlyData()) {
+      // SSL_write_early_data() doesn't work through the stream.
+      ssl_socket_.lowest_layer().non_blocking(true);
+      SSL_set_connect_state(ssl);
+      direct_io_.reset(new utility::DirectSocketIo(
+          ssl, static_cast<int>(ssl_socket_.lowest_layer().native_handle())));
+
+      WriteEarlyData();
+    } else {
+      AsyncHandshake();
+    }
+  }
+}
+
+bool Client::CanSendEarlyData() const {
+  return early_data_ && session_ != nullptr &&
+         SSL_SESSION_get_max_early_data(session_) >= request_.size();
+}
+
+// Write the ClientHello and the request (as early data) to the socket, then
+// let the stream complete the handshake.
+void Client::WriteEarlyData() {
+  SSL* ssl = ssl_socket_.native_handle();
+  auto data = request_.data();
+
+  while (early_data_written_ < data.size()) {
+    std::size_t written = 0;
+    int ret = SSL_write_early_data(
+        ssl, static_cast<const char*>(data.data()) + early_data_written_,
+        data.size() - early_data_written_, &written);
+
+    if (ret != 1) {
+      int error = SSL_get_error(ssl, ret);
+      if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        ssl_socket_.lowest_layer().async_wait(
+            error == SSL_ERROR_WANT_READ ? tcp::socket::wait_read
+                                         : tcp::socket::wait_write,
+            std::bind(&Client::EarlyDataWaitHandler, this,
+                      std::placeholders::_1));
+      } else {
+        std::cerr << "Early data failed." << std::endl;
+      }
+      return;
+    }
+
+    early_data_written_ += written;
+  }
+
+  early_data_sent_ = true;
+
+  direct_io_.reset();
+  AsyncHandshake();
+}
 
+void Client::EarlyDataWaitHandler(boost::system::error_code ec) {
+  if (ec) {
+    std::cerr << "Early data failed: " << ec.message() << std::endl;
+  } else {
+    WriteEarlyData();
   }
 }
 
+void Client::AsyncHandshake() {
+  // HandshakeHandler: void (boost::system::error_code)
+  ssl_socket_.async_handshake(ssl::stream_base::client,
+                              std::bind(&Client::HandshakeHandler,
+                                        this,
+                                        std::placeholders::_1));
+}
+
 void Client::HandshakeHandler(boost::system::error_code ec) {
   if (ec) {
     std::cerr << "Handshake failed: " << ec.message() << std::endl;
-  } else {
-    AsyncWrite();
+    return;
   }
+
+  if (early_data_sent_) {
+    if (SSL_get_early_data_status(ssl_socket_.native_handle()) ==
+        SSL_EARLY_DATA_ACCEPTED) {
+      early_data_status_ = "accepted";
+      request_.consume(request_.size());
+      AsyncReadSome();
+      return;
+    }
+
+    // The server has discarded the early data, send the request again.
+    early_data_status_ = "rejected";
+  }
+
+  AsyncWrite();
 }
 
 void Client::AsyncWrite() {
-  std::ostream request_stream(&request_);
-  request_stream << "GET " << path_ << " HTTP/1.1\r\n";
-  request_stream << "Host: " << host_ << "\r\n\r\n";
-
   // WriteHandler: void (boost::system::error_code, std::size_t)
   boost::asio::async_write(ssl_socket_, request_,
                            std::bind(&Client::WriteHandler, this,
@@ -143,39 +299,135 @@ void Client::AsyncReadSome() {
 
 
 void Client::ReadHandler(boost::system::error_code ec, std::size_t length) {
-  if (ec) {
-    std::cout << ec.message() << std::endl;
-  } else {
-    std::cout.write(buffer_.data(), length);
+  if (length > 0 && ttfb_ == std::chrono::steady_clock::duration(0)) {
+    ttfb_ = std::chrono::steady_clock::now() - start_;
+  }
 
-    // TODO: Call AsyncReadSome() to read until the end.
+  if (!decoder_.Feed(buffer_.data(), length)) {
+    std::cerr << "Failed to decode the response." << std::endl;
+    return;
   }
+
+  if (decoder_.done()) {
+    return;
+  }
+
+  if (ec) {
+    // Many servers close the connection without a TLS close_notify.
+    if (ec == boost::asio::error::eof || ec == ssl::error::stream_truncated) {
+      if (!decoder_.Finish()) {
+        std::cerr << "Incomplete response." << std::endl;
+      }
+    } else {
+      std::cerr << "Read failed: " << ec.message() << std::endl;
+    }
+    return;
+  }
+
+  // Read until the end.
+  AsyncReadSome();
+}
+
+void Client::OnBody(const char* data, std::size_t size) {
+  std::cout.write(data, size);
+}
+
+SSL_SESSION* Client::GetSession() {
+  SSL* ssl = ssl_socket_.native_handle();
+
+  // The connection is over. Without a shutdown, OpenSSL would mark the
+  // session as not resumable when the stream is destroyed.
+  SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+
+  return SSL_get1_session(ssl);
 }
 
 // -----------------------------------------------------------------------------
 
 void Help(const char* argv0) {
-  std::cout << "Usage: " << argv0 << " <host> <path>" << std::endl;
+  std::cout << "Usage: " << argv0 << " <host> <path> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --port=<port>     Default: https" << std::endl;
+  std::cout << "    --gzip            Accept gzip/deflate." << std::endl;
+  std::cout << "    --repeat=<n>      Requests on new, resumed connections."
+            << std::endl;
+  std::cout << "    --early-data      Send the request as TLS 1.3 early data."
+            << std::endl;
   std::cout << "  E.g.," << std::endl;
   std::cout << "    " << argv0 << " www.boost.org /LICENSE_1_0.txt" << std::endl;
   std::cout << "    " << argv0 << " www.google.com /" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
     Help(argv[0]);
     return 1;
   }
 
-  std::string host = argv[1];
-  std::string path = argv[2];
+  std::string host = options.args()[0];
+  std::string path = options.args()[1];
+  std::string port = options.Get("port", "https");
 
-  try {
-    boost::asio::io_context io_context;
+  bool accept_encoding = options.Has("gzip");
+  if (accept_encoding && !utility::HttpResponseDecoder::SupportsCompression()) {
+    std::cerr << "Built without zlib, --gzip is ignored." << std::endl;
+    accept_encoding = false;
+  }
 
-    Client client(io_context, host, path);
+  long repeat = options.GetInt("repeat", 1);
+  bool early_data = options.Has("early-data");
 
-    io_context.run();
+  try {
+    ssl::context ssl_context(ssl::context::sslv23);
+
+    // Use the default paths for finding CA certificates.
+    ssl_context.set_default_verify_paths();
+
+    SSL_SESSION* session = nullptr;
+
+    for (long i = 0; i < repeat; ++i) {
+      boost::asio::io_context io_context;
+
+      auto start = std::chrono::steady_clock::now();
+
+      Client client(io_context, ssl_context, host, path, port,
+                    accept_encoding, session, early_data);
+
+      io_context.run();
+
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+
+      const utility::HttpResponseDecoder& decoder = client.decoder();
+      std::cerr << std::endl << decoder.status_line() << std::endl;
+      std::cerr << "Body: " << decoder.wire_body_size()
+                << " bytes on the wire";
+      if (!decoder.content_encoding().empty()) {
+        std::cerr << " (" << decoder.content_encoding() << ")";
+      }
+      std::cerr << ", " << decoder.decoded_body_size() << " bytes decoded, "
+                << elapsed.count() << " ms" << std::endl;
+
+      std::chrono::duration<double, std::milli> ttfb = client.ttfb();
+      std::string alpn = utility::GetAlpnProtocol(client.ssl());
+      std::cerr << utility::DescribeTlsConnection(client.ssl())
+                << ", ALPN: " << (alpn.empty() ? "none" : alpn)
+                << ", resumed: "
+                << (SSL_session_reused(client.ssl()) ? "yes" : "no")
+                << ", early data: " << client.early_data_status()
+                << ", TTFB: " << ttfb.count() << " ms" << std::endl;
+
+      if (session != nullptr) {
+        SSL_SESSION_free(session);
+      }
+      session = client.GetSession();
+    }
+
+    if (session != nullptr) {
+      SSL_SESSION_free(session);
+    }
 
   } catch (const std::exception& e) {
     std::cout << "Exception: " << e.what() << std::endl;
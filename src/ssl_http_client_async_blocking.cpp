@@ -13,6 +13,8 @@
 #include "boost/lambda/bind.hpp"
 #include "boost/lambda/lambda.hpp"
 
+#include "utility.h"
+
 // -----------------------------------------------------------------------------
 
 using boost::asio::ip::tcp;
@@ -27,7 +29,8 @@ typedef ssl::stream<tcp::socket> ssl_socket;
 
 class Client {
 public:
-  Client(const std::string& host, const std::string& path);
+  Client(const std::string& host, const std::string& path,
+         const std::string& port = "https");
 
   bool Request();
 
@@ -44,6 +47,7 @@ private:
 
   std::string host_;
   std::string path_;
+  std::string port_;
 
   ssl::context ssl_context_;
   ssl::stream<tcp::socket> ssl_socket_;
@@ -55,8 +59,9 @@ private:
 
 // -----------------------------------------------------------------------------
 
-Client::Client(const std::string& host, const std::string& path)
-    : host_(host), path_(path),
+Client::Client(const std::string& host, const std::string& path,
+               const std::string& port)
+    : host_(host), path_(path), port_(port),
       ssl_context_(ssl::context::sslv23),
       ssl_socket_(io_context_, ssl_context_),
       buffer_(1024) {
@@ -86,7 +91,7 @@ bool Client::Connect() {
 
   // Get a list of endpoints corresponding to the server name.
   tcp::resolver resolver(io_context_);
-  auto endpoints = resolver.resolve(host_, "https", ec);
+  auto endpoints = resolver.resolve(host_, port_, ec);
 
   if (ec) {
     std::cerr << "Resolve failed: " << ec.message() << std::endl;
@@ -139,6 +144,10 @@ bool Client::Handshake() {
   ssl_socket_.async_handshake(ssl::stream_base::client,
                               boost::lambda::var(ec) = boost::lambda::_1);
 
+  // The io_context stops when it runs out of work, i.e., after the previous
+  // operation has completed. Restart it before running it again.
+  io_context_.restart();
+
   // Block until the asynchronous operation has completed.
   do {
     io_context_.run_one();
@@ -163,6 +172,8 @@ bool Client::SendRequest() {
   boost::asio::async_write(ssl_socket_, request_,
                            boost::lambda::var(ec) = boost::lambda::_1);
 
+  io_context_.restart();
+
   // Block until the asynchronous operation has completed.
   do {
     io_context_.run_one();
@@ -194,6 +205,8 @@ bool Client::ReadResponse() {
         // TODO: Call ReadResponse() to read until the end.
       });
 
+  io_context_.restart();
+
   // Block until the asynchronous operation has completed.
   do {
     io_context_.run_one();
@@ -210,23 +223,27 @@ bool Client::ReadResponse() {
 // -----------------------------------------------------------------------------
 
 void Help(const char* argv0) {
-  std::cout << "Usage: " << argv0 << " <host> <path>" << std::endl;
+  std::cout << "Usage: " << argv0 << " <host> <path> [--port=<port>]"
+            << std::endl;
   std::cout << "  E.g.," << std::endl;
   std::cout << "    " << argv0 << " www.boost.org /LICENSE_1_0.txt" << std::endl;
   std::cout << "    " << argv0 << " www.google.com /" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
     Help(argv[0]);
     return 1;
   }
 
-  std::string host = argv[1];
-  std::string path = argv[2];
+  std::string host = options.args()[0];
+  std::string path = options.args()[1];
+  std::string port = options.Get("port", "https");
 
   try {
-    Client client(host, path);
+    Client client(host, path, port);
 
     client.Request();
 
@@ -1,6 +1,8 @@
 // HTTPs client sending a GET request.
 // Based on Asio asynchronous APIs but run in blocking mode.
 // A deadline timer is added for timeout control.
+// With --gzip, "Accept-Encoding: gzip, deflate" is sent and the response body
+// is inflated chunk by chunk as it arrives.
 
 #include <chrono>
 #include <iostream>
@@ -13,6 +15,9 @@
 #include "boost/lambda/bind.hpp"
 #include "boost/lambda/lambda.hpp"
 
+#include "http_response_decoder.h"
+#include "utility.h"
+
 // -----------------------------------------------------------------------------
 
 using boost::asio::ip::tcp;
@@ -33,7 +38,8 @@ const int kMaxReceiveSeconds = 5;
 
 class Client {
 public:
-  Client(const std::string& host, const std::string& path);
+  Client(const std::string& host, const std::string& path,
+         const std::string& port = "https");
 
   bool Request();
 
@@ -44,6 +50,10 @@ public:
 
   bool timed_out() const { return timed_out_; }
 
+  void set_accept_encoding(bool accept_encoding) {
+    accept_encoding_ = accept_encoding;
+  }
+
   void Stop();
 
 private:
@@ -61,6 +71,7 @@ private:
 
   std::string host_;
   std::string path_;
+  std::string port_;
 
   ssl::context ssl_context_;
   ssl::stream<tcp::socket> ssl_socket_;
@@ -79,19 +90,24 @@ private:
 
   // If the error was caused by timeout or not.
   bool timed_out_;
+
+  // Send "Accept-Encoding: gzip, deflate" or not.
+  bool accept_encoding_;
 };
 
 // -----------------------------------------------------------------------------
 
-Client::Client(const std::string& host, const std::string& path)
-    : host_(host), path_(path),
+Client::Client(const std::string& host, const std::string& path,
+               const std::string& port)
+    : host_(host), path_(path), port_(port),
       ssl_context_(ssl::context::sslv23),
       ssl_socket_(io_context_, ssl_context_),
-      buffer_(1024),
+      buffer_(16 * 1024),
       deadline_(io_context_),
       timeout_seconds_(30),
       stopped_(false),
-      timed_out_(false) {
+      timed_out_(false),
+      accept_encoding_(false) {
   // Use the default paths for finding CA certificates.
   ssl_context_.set_default_verify_paths();
 }
@@ -133,7 +149,7 @@ bool Client::Connect() {
 
   // Get a list of endpoints corresponding to the server name.
   tcp::resolver resolver(io_context_);
-  auto endpoints = resolver.resolve(host_, "https", ec);
+  auto endpoints = resolver.resolve(host_, port_, ec);
 
   if (ec) {
     std::cerr << "Resolve failed: " << ec.message() << std::endl;
@@ -226,7 +242,11 @@ bool Client::Handshake() {
 bool Client::SendRequest() {
   std::ostream request_stream(&request_);
   request_stream << "GET " << path_ << " HTTP/1.1\r\n";
-  request_stream << "Host: " << host_ << "\r\n\r\n";
+  request_stream << "Host: " << host_ << "\r\n";
+  if (accept_encoding_) {
+    request_stream << "Accept-Encoding: gzip, deflate\r\n";
+  }
+  request_stream << "\r\n";
 
   deadline_.expires_after(std::chrono::seconds(kMaxSendSeconds));
 
@@ -251,35 +271,54 @@ bool Client::SendRequest() {
 }
 
 bool Client::ReadResponse() {
-  deadline_.expires_after(std::chrono::seconds(kMaxReceiveSeconds));
-
-  boost::system::error_code ec = boost::asio::error::would_block;
-
-  ssl_socket_.async_read_some(
-      boost::asio::buffer(buffer_),
-      [this, &ec](boost::system::error_code inner_ec, std::size_t length) {
-        ec = inner_ec;
-
-        if (inner_ec || length == 0) {
-          std::cout << "Socket read error." << std::endl;
-          return;
-        }
-
-        std::cout.write(buffer_.data(), length);
-
-        // TODO: Call ReadResponse() to read until the end.
-        ReadResponse();
-      });
-
-  // Block until the asynchronous operation has completed.
-  do {
-    io_context_.run_one();
-  } while (ec == boost::asio::error::would_block);
+  // The body is written out as it's decoded, so only a bounded buffer is
+  // needed no matter how large the response is.
+  utility::HttpResponseDecoder decoder(
+      [](const char* data, std::size_t size) { std::cout.write(data, size); });
+
+  // Read until the end of the response.
+  while (!decoder.done()) {
+    deadline_.expires_after(std::chrono::seconds(kMaxReceiveSeconds));
+
+    boost::system::error_code ec = boost::asio::error::would_block;
+    std::size_t length = 0;
+
+    ssl_socket_.async_read_some(
+        boost::asio::buffer(buffer_),
+        [&ec, &length](boost::system::error_code inner_ec,
+                       std::size_t inner_length) {
+          ec = inner_ec;
+          length = inner_length;
+        });
+
+    // Block until the asynchronous operation has completed.
+    do {
+      io_context_.run_one();
+    } while (ec == boost::asio::error::would_block);
+
+    if (!decoder.Feed(buffer_.data(), length)) {
+      std::cout << "Failed to decode the response." << std::endl;
+      return false;
+    }
+
+    if (ec) {
+      // Many servers close the connection without a TLS close_notify.
+      if ((ec == boost::asio::error::eof ||
+           ec == ssl::error::stream_truncated) && decoder.Finish()) {
+        break;
+      }
+      std::cout << "Read failed: " << ec.message() << std::endl;
+      return false;
+    }
+  }
 
-  if (ec) {
-    std::cout << "Read failed: " << ec.message() << std::endl;
-    return false;
+  std::cerr << std::endl << decoder.status_line() << std::endl;
+  std::cerr << "Body: " << decoder.wire_body_size() << " bytes on the wire";
+  if (!decoder.content_encoding().empty()) {
+    std::cerr << " (" << decoder.content_encoding() << ")";
   }
+  std::cerr << ", " << decoder.decoded_body_size() << " bytes decoded"
+            << std::endl;
 
   return true;
 }
@@ -305,23 +344,34 @@ void Client::CheckDeadline() {
 // -----------------------------------------------------------------------------
 
 void Help(const char* argv0) {
-  std::cout << "Usage: " << argv0 << " <host> <path>" << std::endl;
+  std::cout << "Usage: " << argv0 << " <host> <path> [--port=<port>] [--gzip]"
+            << std::endl;
   std::cout << "  E.g.," << std::endl;
   std::cout << "    " << argv0 << " www.boost.org /LICENSE_1_0.txt" << std::endl;
   std::cout << "    " << argv0 << " www.google.com /" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
     Help(argv[0]);
     return 1;
   }
 
-  std::string host = argv[1];
-  std::string path = argv[2];
+  std::string host = options.args()[0];
+  std::string path = options.args()[1];
+  std::string port = options.Get("port", "https");
+
+  bool accept_encoding = options.Has("gzip");
+  if (accept_encoding && !utility::HttpResponseDecoder::SupportsCompression()) {
+    std::cerr << "Built without zlib, --gzip is ignored." << std::endl;
+    accept_encoding = false;
+  }
 
   try {
-    Client client(host, path);
+    Client client(host, path, port);
+    client.set_accept_encoding(accept_encoding);
 
     client.Request();
 
@@ -0,0 +1,591 @@
+// HTTPs client sending many GET requests concurrently.
+// Based on |ssl_http_client_async_blocking_timeout| but, instead of giving each
+// client a private io_context and a deadline actor, all clients share one
+// io_context run by a pool of threads.
+//   - Each client runs its handlers in its own strand.
+//   - Timeouts are per operation. A single DeadlineScheduler (one steady_timer
+//     for all clients) cancels only the pending operation of the client whose
+//     deadline has passed, instead of closing the whole socket from a
+//     per-client actor.
+// Memory and CPU usage per concurrent request are reported at the end.
+// Run with --private to get the old model (one io_context, one deadline timer
+// and one thread per client) for comparison.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ssl.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+#include "utility.h"
+
+// -----------------------------------------------------------------------------
+
+using boost::asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+
+typedef ssl::stream<tcp::socket> ssl_socket;
+
+typedef std::chrono::steady_clock::duration Duration;
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+// Verify the certificate of the peer (remote host).
+#define SSL_VERIFY 0
+
+// Timeout seconds.
+const int kMaxConnectSeconds = 10;
+const int kMaxHandshakeSeconds = 10;
+const int kMaxSendSeconds = 30;
+const int kMaxReceiveSeconds = 5;
+
+// -----------------------------------------------------------------------------
+
+// Deadlines of all pending operations, served by a single steady_timer.
+// The timer always waits for the earliest deadline. When it expires, the
+// callbacks of all the expired entries are invoked (outside the lock).
+// Thread-safe.
+class DeadlineScheduler {
+public:
+  typedef std::pair<TimePoint, std::uint64_t> Key;
+
+  explicit DeadlineScheduler(boost::asio::io_context& io_context)
+      : timer_(io_context), next_id_(0) {
+  }
+
+  // Add a deadline. The returned key can be used to remove it.
+  Key Add(Duration timeout, std::function<void()> on_expire);
+
+  // Remove a deadline. It's OK if it has already expired.
+  void Remove(const Key& key);
+
+private:
+  void Schedule();
+
+  void OnTimer(boost::system::error_code ec);
+
+  std::mutex mutex_;
+  boost::asio::steady_timer timer_;
+  std::map<Key, std::function<void()>> entries_;
+  std::uint64_t next_id_;
+};
+
+DeadlineScheduler::Key DeadlineScheduler::Add(
+    Duration timeout, std::function<void()> on_expire) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Key key(std::chrono::steady_clock::now() + timeout, next_id_++);
+  entries_[key] = std::move(on_expire);
+
+  // Only rearm the timer if the new deadline is the earliest one.
+  if (entries_.begin()->first == key) {
+    Schedule();
+  }
+
+  return key;
+}
+
+void DeadlineScheduler::Remove(const Key& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(key);
+
+  // Leave the timer as is unless nothing is left to wait for; a spurious
+  // wakeup is cheaper than a rearm.
+  if (entries_.empty()) {
+    timer_.cancel();
+  }
+}
+
+void DeadlineScheduler::Schedule() {
+  // NOTE: The caller must hold the lock.
+  timer_.expires_at(entries_.begin()->first.first);
+  timer_.async_wait(std::bind(&DeadlineScheduler::OnTimer, this,
+                              std::placeholders::_1));
+}
+
+void DeadlineScheduler::OnTimer(boost::system::error_code ec) {
+  if (ec == boost::asio::error::operation_aborted) {
+    // Rearmed for an earlier deadline.
+    return;
+  }
+
+  std::vector<std::function<void()>> expired;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    TimePoint now = std::chrono::steady_clock::now();
+    while (!entries_.empty() && entries_.begin()->first.first <= now) {
+      expired.push_back(std::move(entries_.begin()->second));
+      entries_.erase(entries_.begin());
+    }
+
+    if (!entries_.empty()) {
+      Schedule();
+    }
+  }
+
+  for (auto& on_expire : expired) {
+    on_expire();
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+struct Stats {
+  std::atomic<std::size_t> succeeded{ 0 };
+  std::atomic<std::size_t> failed{ 0 };
+  std::atomic<std::size_t> timed_out{ 0 };
+  std::atomic<std::size_t> bytes{ 0 };
+  std::atomic<std::int64_t> latency_us{ 0 };
+};
+
+// -----------------------------------------------------------------------------
+
+class Client : public std::enable_shared_from_this<Client> {
+public:
+  typedef std::function<void()> FinishHandler;
+
+  Client(boost::asio::io_context& io_context,
+         ssl::context& ssl_context,
+         DeadlineScheduler& scheduler,
+         const tcp::resolver::results_type& endpoints,
+         const std::string& host, const std::string& path,
+         Stats& stats,
+         FinishHandler on_finish);
+
+  void Start();
+
+private:
+  void Arm(int timeout_seconds);
+  void Disarm();
+  void OnTimeout(std::uint64_t op);
+
+  void OnConnect(boost::system::error_code ec, tcp::endpoint);
+  void OnHandshake(boost::system::error_code ec);
+  void OnWrite(boost::system::error_code ec, std::size_t length);
+
+  void AsyncReadSome();
+  void OnRead(boost::system::error_code ec, std::size_t length);
+
+  void Finish(boost::system::error_code ec);
+
+  // All the handlers of this client are executed in this strand.
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
+  ssl_socket ssl_socket_;
+
+  DeadlineScheduler& scheduler_;
+  DeadlineScheduler::Key deadline_;
+  bool armed_;
+
+  // Sequence number of the pending operation, so that a late timeout can't
+  // cancel the operation following the one it was armed for.
+  std::uint64_t op_;
+
+  bool timed_out_;
+
+  const tcp::resolver::results_type& endpoints_;
+  const std::string& host_;
+  const std::string& path_;
+
+  boost::asio::streambuf request_;
+  std::vector<char> buffer_;
+
+  Stats& stats_;
+  FinishHandler on_finish_;
+  TimePoint start_time_;
+};
+
+// -----------------------------------------------------------------------------
+
+Client::Client(boost::asio::io_context& io_context,
+               ssl::context& ssl_context,
+               DeadlineScheduler& scheduler,
+               const tcp::resolver::results_type& endpoints,
+               const std::string& host, const std::string& path,
+               Stats& stats,
+               FinishHandler on_finish)
+    : strand_(boost::asio::make_strand(io_context)),
+      ssl_socket_(strand_, ssl_context),
+      scheduler_(scheduler),
+      armed_(false),
+      op_(0),
+      timed_out_(false),
+      endpoints_(endpoints),
+      host_(host), path_(path),
+      buffer_(1024),
+      stats_(stats),
+      on_finish_(std::move(on_finish)) {
+}
+
+void Client::Start() {
+  auto self = shared_from_this();
+
+  boost::asio::post(strand_, [this, self]() {
+    start_time_ = std::chrono::steady_clock::now();
+
+    Arm(kMaxConnectSeconds);
+
+    // ConnectHandler: void (boost::system::error_code, tcp::endpoint)
+    boost::asio::async_connect(ssl_socket_.lowest_layer(), endpoints_,
+                               std::bind(&Client::OnConnect, self,
+                                         std::placeholders::_1,
+                                         std::placeholders::_2));
+  });
+}
+
+void Client::Arm(int timeout_seconds) {
+  Disarm();
+
+  std::uint64_t op = ++op_;
+  std::weak_ptr<Client> weak_self = shared_from_this();
+  auto strand = strand_;
+
+  deadline_ = scheduler_.Add(std::chrono::seconds(timeout_seconds),
+                             [weak_self, strand, op]() {
+    // Called from the scheduler, not in our strand.
+    boost::asio::post(strand, [weak_self, op]() {
+      if (auto self = weak_self.lock()) {
+        self->OnTimeout(op);
+      }
+    });
+  });
+
+  armed_ = true;
+}
+
+void Client::Disarm() {
+  if (armed_) {
+    scheduler_.Remove(deadline_);
+    armed_ = false;
+  }
+}
+
+void Client::OnTimeout(std::uint64_t op) {
+  if (op != op_ || !armed_) {
+    // The operation has already completed.
+    return;
+  }
+
+  timed_out_ = true;
+  armed_ = false;
+
+  // Cancel the pending operation only. The socket is left open; the
+  // operation will complete with |operation_aborted|.
+  boost::system::error_code ignored_ec;
+  ssl_socket_.lowest_layer().cancel(ignored_ec);
+}
+
+void Client::OnConnect(boost::system::error_code ec, tcp::endpoint) {
+  if (ec) {
+    Finish(ec);
+    return;
+  }
+
+#if SSL_VERIFY
+  ssl_socket_.set_verify_mode(ssl::verify_peer);
+#else
+  ssl_socket_.set_verify_mode(ssl::verify_none);
+#endif  // SSL_VERIFY
+
+#if BOOST_VERSION < 107300
+  ssl_socket_.set_verify_callback(ssl::rfc2818_verification(host_));
+#else
+  ssl_socket_.set_verify_callback(ssl::host_name_verification(host_));
+#endif  // BOOST_VERSION < 107300
+
+  // Server Name Indication (SNI).
+  SSL_set_tlsext_host_name(ssl_socket_.native_handle(), host_.c_str());
+
+  Arm(kMaxHandshakeSeconds);
+
+  ssl_socket_.async_handshake(ssl::stream_base::client,
+                              std::bind(&Client::OnHandshake,
+                                        shared_from_this(),
+                                        std::placeholders::_1));
+}
+
+void Client::OnHandshake(boost::system::error_code ec) {
+  if (ec) {
+    Finish(ec);
+    return;
+  }
+
+  std::ostream request_stream(&request_);
+  request_stream << "GET " << path_ << " HTTP/1.1\r\n";
+  request_stream << "Host: " << host_ << "\r\n";
+  // Let the server close the connection so that the end of the response is
+  // simply the end of the stream.
+  request_stream << "Connection: close\r\n\r\n";
+
+  Arm(kMaxSendSeconds);
+
+  boost::asio::async_write(ssl_socket_, request_,
+                           std::bind(&Client::OnWrite, shared_from_this(),
+                                     std::placeholders::_1,
+                                     std::placeholders::_2));
+}
+
+void Client::OnWrite(boost::system::error_code ec, std::size_t length) {
+  if (ec) {
+    Finish(ec);
+  } else {
+    AsyncReadSome();
+  }
+}
+
+void Client::AsyncReadSome() {
+  // The receive timeout is per read, i.e., it's an idle timeout.
+  Arm(kMaxReceiveSeconds);
+
+  ssl_socket_.async_read_some(boost::asio::buffer(buffer_),
+                              std::bind(&Client::OnRead, shared_from_this(),
+                                        std::placeholders::_1,
+                                        std::placeholders::_2));
+}
+
+void Client::OnRead(boost::system::error_code ec, std::size_t length) {
+  stats_.bytes += length;
+
+  if (!ec) {
+    AsyncReadSome();
+    return;
+  }
+
+  // Many servers close the connection without a TLS close_notify.
+  if (ec == boost::asio::error::eof || ec == ssl::error::stream_truncated) {
+    ec.clear();
+  }
+
+  Finish(ec);
+}
+
+void Client::Finish(boost::system::error_code ec) {
+  Disarm();
+
+  if (timed_out_) {
+    ++stats_.timed_out;
+  } else if (ec) {
+    ++stats_.failed;
+  } else {
+    ++stats_.succeeded;
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start_time_;
+  stats_.latency_us +=
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+  boost::system::error_code ignored_ec;
+  ssl_socket_.lowest_layer().close(ignored_ec);
+
+  on_finish_();
+}
+
+// -----------------------------------------------------------------------------
+
+// Keep |concurrency| requests in flight until |requests| are done.
+// In the shared mode, there's one io_context and one scheduler for all the
+// clients; in the private mode, each client slot has its own.
+class Runner {
+public:
+  Runner(const std::string& host, const std::string& path,
+         const std::string& port, std::size_t requests,
+         std::size_t concurrency, std::size_t threads, bool private_mode);
+
+  void Run();
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Slot {
+    explicit Slot(boost::asio::io_context& io_context)
+        : scheduler(io_context) {
+    }
+
+    DeadlineScheduler scheduler;
+  };
+
+  void StartNext(boost::asio::io_context& io_context, Slot& slot);
+
+  std::string host_;
+  std::string path_;
+  std::string port_;
+
+  std::size_t concurrency_;
+  std::size_t threads_;
+  bool private_mode_;
+
+  std::atomic<std::size_t> remaining_;
+
+  ssl::context ssl_context_;
+  tcp::resolver::results_type endpoints_;
+
+  Stats stats_;
+};
+
+Runner::Runner(const std::string& host, const std::string& path,
+               const std::string& port, std::size_t requests,
+               std::size_t concurrency, std::size_t threads, bool private_mode)
+    : host_(host), path_(path), port_(port),
+      concurrency_(concurrency), threads_(threads),
+      private_mode_(private_mode),
+      remaining_(requests),
+      ssl_context_(ssl::context::sslv23) {
+  // Use the default paths for finding CA certificates.
+  ssl_context_.set_default_verify_paths();
+}
+
+void Runner::StartNext(boost::asio::io_context& io_context, Slot& slot) {
+  // Claim one of the remaining requests.
+  std::size_t remaining = remaining_.load();
+  do {
+    if (remaining == 0) {
+      return;
+    }
+  } while (!remaining_.compare_exchange_weak(remaining, remaining - 1));
+
+  auto client = std::make_shared<Client>(
+      io_context, ssl_context_, slot.scheduler, endpoints_, host_, path_,
+      stats_, [this, &io_context, &slot]() { StartNext(io_context, slot); });
+  client->Start();
+}
+
+void Runner::Run() {
+  {
+    // Resolve once for all the clients.
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    endpoints_ = resolver.resolve(host_, port_);
+  }
+
+  if (!private_mode_) {
+    boost::asio::io_context io_context;
+    Slot slot(io_context);
+
+    for (std::size_t i = 0; i < concurrency_; ++i) {
+      StartNext(io_context, slot);
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < threads_; ++i) {
+      threads.emplace_back([&io_context]() { io_context.run(); });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+
+  } else {
+    // One io_context, one deadline timer and one thread per client.
+    std::vector<std::unique_ptr<boost::asio::io_context>> io_contexts;
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    for (std::size_t i = 0; i < concurrency_; ++i) {
+      io_contexts.emplace_back(new boost::asio::io_context(1));
+      slots.emplace_back(new Slot(*io_contexts.back()));
+      StartNext(*io_contexts.back(), *slots.back());
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& io_context : io_contexts) {
+      boost::asio::io_context* p = io_context.get();
+      threads.emplace_back([p]() { p->run(); });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <host> <path> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --port=<port>         Default: https" << std::endl;
+  std::cout << "    --requests=<n>        Total requests. Default: 100"
+            << std::endl;
+  std::cout << "    --concurrency=<n>     Requests in flight. Default: 10"
+            << std::endl;
+  std::cout << "    --threads=<n>         Threads running the io_context."
+            << " Default: #cores" << std::endl;
+  std::cout << "    --private             One io_context per client."
+            << std::endl;
+  std::cout << "  E.g.," << std::endl;
+  std::cout << "    " << argv0 << " www.boost.org /LICENSE_1_0.txt"
+            << " --requests=1000 --concurrency=200" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::size_t threads = std::thread::hardware_concurrency();
+  threads = options.GetInt("threads", threads > 0 ? threads : 1);
+
+  std::size_t requests = options.GetInt("requests", 100);
+  std::size_t concurrency = options.GetInt("concurrency", 10);
+  bool private_mode = options.Has("private");
+
+  try {
+    Runner runner(options.args()[0], options.args()[1],
+                  options.Get("port", "https"), requests, concurrency,
+                  threads, private_mode);
+
+    std::size_t rss_before = utility::GetResidentMemory();
+    double cpu_before = utility::GetCpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+
+    runner.Run();
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    double cpu = utility::GetCpuSeconds() - cpu_before;
+    std::size_t rss_peak = utility::GetPeakResidentMemory();
+
+    const Stats& stats = runner.stats();
+    std::size_t done = stats.succeeded + stats.failed + stats.timed_out;
+
+    std::cout << "Mode: " << (private_mode ? "private" : "shared")
+              << ", concurrency: " << concurrency
+              << ", threads: " << (private_mode ? concurrency : threads)
+              << std::endl;
+    std::cout << "Requests: " << done << " (succeeded: " << stats.succeeded
+              << ", failed: " << stats.failed
+              << ", timed out: " << stats.timed_out << ")" << std::endl;
+    std::cout << "Bytes received: " << stats.bytes << std::endl;
+    std::cout << "Elapsed: " << seconds << " s, "
+              << (done / seconds) << " requests/s" << std::endl;
+
+    if (done > 0) {
+      std::cout << "Average latency: "
+                << (stats.latency_us / 1000.0 / done) << " ms" << std::endl;
+      std::cout << "CPU per request: " << (cpu * 1e6 / done) << " us"
+                << std::endl;
+    }
+
+    if (rss_peak > rss_before && concurrency > 0) {
+      std::cout << "Memory per concurrent request: "
+                << (rss_peak - rss_before) / concurrency << " bytes"
+                << std::endl;
+    }
+
+  } catch (const std::exception& e) {
+    std::cout << "Exception: " << e.what() << std::endl;
+  }
+
+  return 0;
+}
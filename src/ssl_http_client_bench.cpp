@@ -0,0 +1,141 @@
+// Benchmark of the |ssl_http_client_*| examples over loopback.
+// A HttpsStandInServer is run in a background thread, then each client
+// executable given on the command line is run repeatedly against it.
+// Reported per client:
+//   - requests/sec, counted by the server (a client may send many requests
+//     per run, e.g., |ssl_http_client_async_concurrent|)
+//   - latency percentiles of a run, i.e., of a process from start to exit,
+//     including the process startup and the TLS handshake.
+// E.g.,
+//   $ ssl_http_client_bench ./ssl_http_client_sync ./ssl_http_client_async
+//       --runs=100 --size=65536
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/executor_work_guard.hpp"
+#include "boost/asio/io_context.hpp"
+
+#include "https_stand_in_server.h"
+#include "utility.h"
+
+#if defined(_WIN32)
+const char* kNullRedirect = " > NUL 2>&1";
+#else
+const char* kNullRedirect = " > /dev/null 2>&1";
+#endif
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <client>... [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --runs=<n>            Runs per client. Default: 50"
+            << std::endl;
+  std::cout << "    --args=<args>         Extra arguments for the clients."
+            << std::endl;
+  std::cout << "  Server options (see ssl_http_server):" << std::endl;
+  std::cout << "    --size, --delay-ms, --chunked, --chunk-size, "
+            << "--keep-alive, --cert-dir" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.args().empty()) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  HttpsStandInServer::Config config;
+  config.body_size = options.GetInt("size", 1024);
+  config.delay_ms = options.GetInt("delay-ms", 0);
+  config.chunked = options.Has("chunked");
+  config.chunk_size = options.GetInt("chunk-size", 4096);
+  config.keep_alive = options.Has("keep-alive");
+  config.cert_dir = options.Get("cert-dir", SSL_CERT_DIR);
+
+  int runs = options.GetInt("runs", 50);
+  std::string extra_args = options.Get("args");
+
+  try {
+    boost::asio::io_context io_context(1);
+    auto work = boost::asio::make_work_guard(io_context);
+
+    HttpsStandInServer server(io_context, 0, config);
+    std::thread server_thread([&io_context]() { io_context.run(); });
+
+    std::cout << "Server: 127.0.0.1:" << server.port()
+              << ", body: " << config.body_size << " bytes"
+              << (config.chunked ? ", chunked" : "")
+              << (config.keep_alive ? ", keep-alive" : "")
+              << ", delay: " << config.delay_ms << " ms" << std::endl;
+
+    std::cout << std::left << std::setw(42) << "client"
+              << std::right << std::setw(10) << "req/s"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+              << std::setw(10) << "p99 ms" << std::setw(11) << "responses"
+              << std::setw(8) << "failed"
+              << std::endl;
+
+    for (const std::string& client : options.args()) {
+      std::string command = "\"" + client + "\" localhost / --port=" +
+                            std::to_string(server.port()) + " " + extra_args +
+                            kNullRedirect;
+
+      std::vector<double> latencies;
+      int failed = 0;
+
+      std::size_t responses_before = server.responses();
+      auto start = std::chrono::steady_clock::now();
+
+      for (int i = 0; i < runs; ++i) {
+        auto run_start = std::chrono::steady_clock::now();
+
+        int status = std::system(command.c_str());
+
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - run_start).count());
+
+        if (status != 0) {
+          ++failed;
+        }
+      }
+
+      double seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      // The clients don't always return an error code; compare the number
+      // of responses with the number of runs instead.
+      std::size_t responses = server.responses() - responses_before;
+
+      std::sort(latencies.begin(), latencies.end());
+
+      std::string name = client.substr(client.find_last_of("/\\") + 1);
+
+      std::cout << std::left << std::setw(42) << name << std::right
+                << std::fixed << std::setprecision(1)
+                << std::setw(10) << (responses / seconds)
+                << std::setw(10) << utility::Percentile(latencies, 0.5)
+                << std::setw(10) << utility::Percentile(latencies, 0.9)
+                << std::setw(10) << utility::Percentile(latencies, 0.99)
+                << std::setw(11) << responses
+                << std::setw(8) << failed << std::endl;
+    }
+
+    work.reset();
+    io_context.stop();
+    server_thread.join();
+
+  } catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
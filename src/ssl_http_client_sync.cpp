@@ -8,6 +8,8 @@
 #include "boost/asio.hpp"
 #include "boost/asio/ssl.hpp"
 
+#include "utility.h"
+
 using boost::asio::ip::tcp;
 namespace ssl = boost::asio::ssl;
 
@@ -53,20 +55,24 @@ VerboseVerification<Verifier> MakeVerboseVerification(Verifier verifier) {
 // -----------------------------------------------------------------------------
 
 void Help(const char* argv0) {
-  std::cout << "Usage: " << argv0 << " <host> <path>" << std::endl;
+  std::cout << "Usage: " << argv0 << " <host> <path> [--port=<port>]"
+            << std::endl;
   std::cout << "  E.g.," << std::endl;
   std::cout << "    " << argv0 << " www.boost.org /LICENSE_1_0.txt" << std::endl;
   std::cout << "    " << argv0 << " www.google.com /" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
     Help(argv[0]);
     return 1;
   }
 
-  std::string host = argv[1];
-  std::string path = argv[2];
+  std::string host = options.args()[0];
+  std::string path = options.args()[1];
+  std::string port = options.Get("port", "https");
 
   try {
     boost::asio::io_context io_context;
@@ -87,7 +93,7 @@ int main(int argc, char* argv[]) {
 
     // Get a list of endpoints corresponding to the server name.
     tcp::resolver resolver(io_context);
-    auto endpoints = resolver.resolve(host, "https");  // TODO: "https"
+    auto endpoints = resolver.resolve(host, port);
 
     // Try each endpoint until we successfully establish a connection.
     ssl::stream<tcp::socket> ssl_socket(io_context, ssl_context);
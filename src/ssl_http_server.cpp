@@ -0,0 +1,65 @@
+// Local HTTPS server standing in for the real hosts used by the
+// |ssl_http_client_*| examples.
+// E.g.,
+//   $ ssl_http_server 8443 --size=65536 --chunked --keep-alive
+//   $ ssl_http_client_async localhost / --port=8443
+//   $ ssl_http_server 8443 --early-data=16384
+//   $ ssl_http_client_async localhost / --port=8443 --repeat=3 --early-data
+
+#include <cstdlib>
+#include <iostream>
+
+#include "boost/asio/io_context.hpp"
+
+#include "https_stand_in_server.h"
+#include "utility.h"
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <port> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --size=<bytes>        Body size. Default: 1024" << std::endl;
+  std::cout << "    --delay-ms=<ms>       Delay of each response." << std::endl;
+  std::cout << "    --chunked             Transfer-Encoding: chunked."
+            << std::endl;
+  std::cout << "    --chunk-size=<bytes>  Default: 4096" << std::endl;
+  std::cout << "    --keep-alive          Keep connections alive." << std::endl;
+  std::cout << "    --early-data=<bytes>  Accept TLS 1.3 early data (0-RTT)."
+            << std::endl;
+  std::cout << "    --cert-dir=<dir>      Directory of server.pem, etc."
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 1) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  HttpsStandInServer::Config config;
+  config.body_size = options.GetInt("size", 1024);
+  config.delay_ms = options.GetInt("delay-ms", 0);
+  config.chunked = options.Has("chunked");
+  config.chunk_size = options.GetInt("chunk-size", 4096);
+  config.keep_alive = options.Has("keep-alive");
+  config.max_early_data = options.GetInt("early-data", 0);
+  config.cert_dir = options.Get("cert-dir", SSL_CERT_DIR);
+
+  try {
+    boost::asio::io_context io_context(1);
+
+    unsigned short port = std::atoi(options.args()[0].c_str());
+    HttpsStandInServer server(io_context, port, config);
+
+    std::cout << "Listening on 127.0.0.1:" << server.port() << std::endl;
+
+    io_context.run();
+
+  } catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
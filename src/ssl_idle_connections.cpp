@@ -0,0 +1,340 @@
+// Opens many idle TLS connections to a server (e.g., |ssl_server|) and reports
+// the resident memory of the server per connection at each step.
+// The client only keeps the sockets: the SSL object of a connection is freed
+// right after its handshake (without a close_notify), so the client itself
+// stays small. The source address rotates over 127.0.0.1 ~ 127.0.0.N to get
+// beyond the ephemeral ports of one address (loopback only).
+// Both processes need an open file limit above the connections; the limit is
+// raised to the hard limit (see utility::RaiseOpenFileLimit()).
+// E.g.,
+//   $ ssl_server 8443 --low-memory &
+//   $ ssl_idle_connections 127.0.0.1 8443 --pid=$! --steps=10000,100000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ssl.hpp"
+
+#include "utility.h"
+
+using boost::asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+
+typedef ssl::stream<tcp::socket> ssl_socket;
+
+// The ephemeral ports to use per source address.
+const std::size_t kConnectionsPerSource = 25000;
+
+// -----------------------------------------------------------------------------
+
+class IdleClient {
+public:
+  IdleClient(boost::asio::io_context& io_context, ssl::context& ssl_context,
+             const tcp::endpoint& endpoint, std::size_t concurrency,
+             std::size_t sources, bool resume)
+      : io_context_(io_context), ssl_context_(ssl_context),
+        endpoint_(endpoint), concurrency_(concurrency), sources_(sources),
+        resume_(resume), session_(nullptr), next_source_(0), target_(0),
+        in_flight_(0), failures_(0), stopped_(false) {
+  }
+
+  ~IdleClient() {
+    if (session_ != nullptr) {
+      SSL_SESSION_free(session_);
+    }
+  }
+
+  // Open connections until there are |target| of them, then call |done|.
+  // Stops at the first error opening a socket (e.g., too many open files).
+  void OpenUntil(std::size_t target, std::function<void()> done) {
+    target_ = target;
+    done_ = done;
+    OpenMore();
+  }
+
+  std::size_t connections() const { return sockets_.size(); }
+  std::size_t failures() const { return failures_; }
+
+  // The error that stopped opening connections, if any.
+  const std::string& error() const { return error_; }
+
+private:
+  void OpenMore() {
+    while (!stopped_ && in_flight_ < concurrency_ &&
+           sockets_.size() + in_flight_ < target_) {
+      // The first connection of the resume mode fetches the session alone.
+      if (resume_ && session_ == nullptr && in_flight_ > 0) {
+        break;
+      }
+      Open();
+    }
+
+    if (in_flight_ == 0 && (stopped_ || sockets_.size() >= target_) &&
+        done_) {
+      // Post it so that |done| may call OpenUntil() again.
+      boost::asio::post(io_context_, done_);
+      done_ = nullptr;
+    }
+  }
+
+  void Open() {
+    std::shared_ptr<ssl_socket> stream =
+        std::make_shared<ssl_socket>(io_context_, ssl_context_);
+    tcp::socket& socket = stream->next_layer();
+
+    boost::system::error_code ec;
+    socket.open(endpoint_.protocol(), ec);
+    if (!ec && sources_ > 0) {
+      boost::asio::ip::address_v4 source(
+          boost::asio::ip::address_v4::loopback().to_uint() +
+          static_cast<std::uint32_t>(next_source_++ % sources_));
+      socket.bind(tcp::endpoint(source, 0), ec);
+    }
+    if (ec) {
+      Stop(ec);
+      return;
+    }
+
+    if (resume_ && session_ != nullptr) {
+      SSL_set_session(stream->native_handle(), session_);
+    }
+
+    ++in_flight_;
+
+    socket.async_connect(endpoint_,
+                         [this, stream](boost::system::error_code ec) {
+      if (ec) {
+        Fail(ec);
+        return;
+      }
+      stream->async_handshake(ssl::stream_base::client,
+                              [this, stream](boost::system::error_code ec) {
+        HandleHandshake(stream, ec);
+      });
+    });
+  }
+
+  void HandleHandshake(std::shared_ptr<ssl_socket> stream,
+                       boost::system::error_code ec) {
+    if (ec) {
+      Fail(ec);
+      return;
+    }
+
+    if (resume_ && session_ == nullptr) {
+      FetchSession(stream);
+      return;
+    }
+
+    Keep(stream);
+  }
+
+  // With TLS 1.3, the session ticket only arrives after the handshake; echo
+  // a byte to read it.
+  void FetchSession(std::shared_ptr<ssl_socket> stream) {
+    std::shared_ptr<char> byte = std::make_shared<char>('x');
+    boost::asio::async_write(
+        *stream, boost::asio::buffer(byte.get(), 1),
+        [this, stream, byte](boost::system::error_code ec, std::size_t) {
+      if (ec) {
+        Fail(ec);
+        return;
+      }
+      boost::asio::async_read(
+          *stream, boost::asio::buffer(byte.get(), 1),
+          [this, stream, byte](boost::system::error_code ec, std::size_t) {
+        if (ec) {
+          Fail(ec);
+          return;
+        }
+        session_ = SSL_get1_session(stream->native_handle());
+        Keep(stream);
+      });
+    });
+  }
+
+  // Keep the socket only; the SSL object is freed with the stream.
+  void Keep(std::shared_ptr<ssl_socket> stream) {
+    --in_flight_;
+    sockets_.push_back(std::move(stream->next_layer()));
+    OpenMore();
+  }
+
+  void Fail(boost::system::error_code ec) {
+    --in_flight_;
+    ++failures_;
+    if (failures_ > 100) {
+      Stop(ec);
+    }
+    OpenMore();
+  }
+
+  void Stop(boost::system::error_code ec) {
+    if (!stopped_) {
+      stopped_ = true;
+      error_ = ec.message();
+    }
+  }
+
+  boost::asio::io_context& io_context_;
+  ssl::context& ssl_context_;
+  tcp::endpoint endpoint_;
+
+  std::size_t concurrency_;  // Handshakes in flight
+  std::size_t sources_;      // Source addresses, 0 to not bind
+  bool resume_;
+  SSL_SESSION* session_;
+
+  std::size_t next_source_;
+  std::size_t target_;
+  std::size_t in_flight_;
+  std::size_t failures_;
+  bool stopped_;
+  std::string error_;
+
+  std::function<void()> done_;
+
+  std::vector<tcp::socket> sockets_;  // The idle connections
+};
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::size_t> ParseSteps(const std::string& str) {
+  std::vector<std::size_t> steps;
+  std::istringstream stream(str);
+  std::string step;
+  while (std::getline(stream, step, ',')) {
+    std::size_t n = std::strtoul(step.c_str(), nullptr, 10);
+    if (n > 0) {
+      steps.push_back(n);
+    }
+  }
+  std::sort(steps.begin(), steps.end());
+  return steps;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <host> <port> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --steps=<n,...>    Default: 10000,100000,1000000"
+            << std::endl;
+  std::cout << "    --pid=<pid>        The server to measure." << std::endl;
+  std::cout << "    --concurrency=<n>  Handshakes in flight. Default: 100"
+            << std::endl;
+  std::cout << "    --sources=<n>      Source addresses 127.0.0.1 ~ n."
+            << std::endl;
+  std::cout << "    --resume           Resume a TLS session (faster)."
+            << std::endl;
+  std::cout << "    --hold=<seconds>   Keep the connections open at the end."
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 2) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::vector<std::size_t> steps =
+      ParseSteps(options.Get("steps", "10000,100000,1000000"));
+  if (steps.empty()) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  int pid = static_cast<int>(options.GetInt("pid", 0));
+  std::size_t concurrency = options.GetInt("concurrency", 100);
+  bool resume = options.Has("resume");
+  long hold = options.GetInt("hold", 0);
+
+  std::size_t file_limit = utility::RaiseOpenFileLimit();
+  std::cout << "Open file limit: " << file_limit << std::endl;
+
+  try {
+    boost::asio::io_context io_context(1);
+
+    tcp::resolver resolver(io_context);
+    tcp::endpoint endpoint =
+        resolver.resolve(options.args()[0], options.args()[1]).begin()
+            ->endpoint();
+
+    // Enough source addresses for the largest step, on loopback only.
+    std::size_t sources = 0;
+    if (endpoint.address().is_loopback() && endpoint.address().is_v4()) {
+      sources = options.GetInt(
+          "sources", steps.back() / kConnectionsPerSource + 1);
+      sources = (std::min)(sources, static_cast<std::size_t>(254));
+    }
+
+    // Memory only; the certificate isn't verified.
+    ssl::context ssl_context(ssl::context::sslv23);
+    ssl_context.set_verify_mode(ssl::verify_none);
+
+    IdleClient client(io_context, ssl_context, endpoint, concurrency,
+                      sources, resume);
+
+    std::size_t baseline = pid > 0 ? utility::GetResidentMemory(pid) : 0;
+    if (pid > 0) {
+      std::cout << "Server RSS: " << baseline / 1024 << " KB" << std::endl;
+    }
+
+    std::size_t step = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::function<void()> on_step = [&]() {
+      // Let the server settle.
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      std::size_t n = client.connections();
+      std::cout << "connections: " << n << " (" << elapsed.count() << " s)";
+      if (pid > 0 && n > 0) {
+        std::size_t rss = utility::GetResidentMemory(pid);
+        std::cout << ", server RSS: " << rss / (1024 * 1024) << " MB"
+                  << ", per connection: "
+                  << (static_cast<double>(rss) - baseline) / n / 1024
+                  << " KB";
+      }
+      std::cout << ", client RSS: "
+                << utility::GetResidentMemory() / (1024 * 1024) << " MB"
+                << ", failures: " << client.failures() << std::endl;
+
+      if (!client.error().empty()) {
+        std::cout << "Stopped: " << client.error() << std::endl;
+        return;
+      }
+
+      if (++step < steps.size()) {
+        client.OpenUntil(steps[step], on_step);
+      }
+    };
+
+    client.OpenUntil(steps[step], on_step);
+
+    io_context.run();
+
+    if (hold > 0) {
+      std::this_thread::sleep_for(std::chrono::seconds(hold));
+    }
+
+  } catch (const std::exception& e) {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
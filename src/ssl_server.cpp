@@ -1,80 +1,841 @@
+// Asynchronous SSL (TLS) echo server.
+// Sessions are managed by std::shared_ptr instead of raw new/delete, so that
+// the server can be run by more than one thread:
+//   - Thread pool (default): one io_context run by N threads, each session in
+//     its own strand.
+//   - Per core (--per-core): N io_contexts each run by one thread; sessions are
+//     assigned to them round-robin, no strand needed.
+// With --handshake-threads=N, the TLS handshakes run in a separate pool of N
+// threads so that a burst of new connections doesn't stall the established
+// sessions; a session is handed back to its own executor (the data path) once
+// the handshake has completed.
+// The protocol versions, cipher suites and key exchange groups are given by a
+// profile (--tls-profile), see utility::ApplyTlsProfile().
+// Session resumption: a server side session cache (--session-cache,
+// --session-ttl) and stateless session tickets whose keys are rotated in
+// process (--ticket-rotation).
+// With --ktls (Linux, OpenSSL 3), the record encryption after the handshake
+// is offloaded to the kernel (kTLS) when the kernel and the cipher allow it;
+// otherwise OpenSSL does it in user space as usual.
+// With --low-memory, an idle session keeps no buffer: OpenSSL frees its
+// record buffers when empty, and the session waits for the socket to be
+// readable before allocating its own.
+// With --coalesce, the echoed data is accumulated up to a full TLS record
+// (16 KB), or until a small flush deadline (--flush-us), before each
+// encrypted write, instead of one record per 1 KB read.
+// Admission control of the handshakes: the accepted connections are queued,
+// and a handshake is only started while the handshakes in progress are below
+// a cap (--max-handshakes) and a token bucket allows (--handshake-rate,
+// --handshake-burst). Connections queued longer than --max-queue-delay-ms are
+// closed (shed). This keeps a reconnect storm from starving the established
+// sessions.
+// With --stats, handshakes/sec and echo throughput are printed every second.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "boost/asio.hpp"
 #include "boost/asio/ssl.hpp"
 
+#include "tls_utility.h"
+#include "utility.h"
+
 using boost::asio::ip::tcp;
 namespace ssl = boost::asio::ssl;
 
 typedef ssl::stream<tcp::socket> ssl_socket;
 
+// Kernel TLS needs Linux and OpenSSL 3 built with kTLS.
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) && \
+    !defined(OPENSSL_NO_KTLS)
+#define KTLS_SUPPORTED 1
+#else
+#define KTLS_SUPPORTED 0
+#endif
+
+// The max plaintext size of a TLS record.
+const std::size_t kTlsRecordSize = SSL3_RT_MAX_PLAIN_LENGTH;
+
+// The number of TLS records a write of |length| bytes is split into.
+inline std::size_t CountRecords(std::size_t length) {
+  return (length + kTlsRecordSize - 1) / kTlsRecordSize;
+}
+
+// -----------------------------------------------------------------------------
+
+// Counters shared by all sessions.
+struct Stats {
+  std::atomic<std::size_t> sessions{ 0 };  // Live sessions
+  std::atomic<std::size_t> handshaking{ 0 };  // Handshakes in progress
+  std::atomic<std::size_t> handshakes{ 0 };
+  std::atomic<std::size_t> resumed{ 0 };  // Abbreviated handshakes
+  std::atomic<std::size_t> handshake_errors{ 0 };
+  std::atomic<std::size_t> bytes{ 0 };  // Echoed bytes
+  std::atomic<std::size_t> records{ 0 };  // TLS records written
+
+  // kTLS sessions: offloaded in both directions, only one, or none.
+  std::atomic<std::size_t> ktls_offloaded{ 0 };
+  std::atomic<std::size_t> ktls_partial{ 0 };
+  std::atomic<std::size_t> ktls_fallback{ 0 };
+
+  // Admission control.
+  std::atomic<std::size_t> queued{ 0 };  // Connections waiting to handshake
+  std::atomic<std::size_t> shed{ 0 };  // Connections closed while waiting
+  std::atomic<std::size_t> max_queue_delay_us{ 0 };  // Since last reset
+};
+
+// Called once a handshake is over, successful or not.
+typedef std::function<void()> HandshakeDone;
+
+// -----------------------------------------------------------------------------
+
+// Write coalescing.
+struct Coalescing {
+  bool enabled = false;
+
+  // The max time the first byte of a record waits for the rest of it.
+  std::chrono::microseconds flush_delay{ 200 };
+};
+
 // -----------------------------------------------------------------------------
 
-class Session {
+class Session : public std::enable_shared_from_this<Session> {
 public:
-  Session(boost::asio::io_context& io_context, ssl::context& ssl_context)
-      : socket_(io_context, ssl_context) {
+  // The executor of |socket| decides where the handlers run, i.e., a strand
+  // or a single-threaded io_context.
+  // The handshake runs in |handshake_executor|.
+  Session(tcp::socket socket, ssl::context& ssl_context, Stats& stats,
+          const boost::asio::any_io_executor& handshake_executor,
+          const Coalescing& coalescing, const HandshakeDone& handshake_done)
+      : socket_(std::move(socket), ssl_context), stats_(stats),
+        handshake_executor_(handshake_executor),
+        handshake_done_(handshake_done),
+        coalescing_(coalescing),
+        flush_timer_(socket_.get_executor()),
+        pending_length_(0),
+        reading_(false), writing_(false), flush_timer_armed_(false),
+        closing_(false) {
+    ++stats_.sessions;
+
+    if (coalescing_.enabled) {
+      // The records are coalesced here already; Nagle's algorithm would only
+      // hold back the tail of a record until the peer's (delayed) ACK.
+      // Not worth ending the session (or the server) if it fails.
+      boost::system::error_code ec;
+      socket_.lowest_layer().set_option(tcp::no_delay(true), ec);
+
+      read_buffer_.resize(kTlsRecordSize);
+      pending_.resize(kTlsRecordSize);
+      writing_buffer_.resize(kTlsRecordSize);
+    }
   }
 
-  ssl_socket::lowest_layer_type& socket() {
-    return socket_.lowest_layer();
+  ~Session() {
+    EndHandshake();
+    --stats_.sessions;
   }
 
   void Start() {
-    socket_.async_handshake(ssl::stream_base::server,
-                            std::bind(&Session::HandleHandshake, this,
-                                      std::placeholders::_1));
+    ++stats_.handshaking;
+
+    // The intermediate handlers of a composed operation run in the executor
+    // associated with the final handler. So binding the handler to the
+    // handshake executor moves the expensive steps of the handshake
+    // (public key operations) there, while the socket itself stays in the
+    // reactor of its own io_context.
+    socket_.async_handshake(
+        ssl::stream_base::server,
+        boost::asio::bind_executor(handshake_executor_,
+                                   std::bind(&Session::HandleHandshake,
+                                             shared_from_this(),
+                                             std::placeholders::_1)));
+  }
+
+private:
+  void EndHandshake() {
+    if (handshake_done_) {
+      handshake_done_();
+      handshake_done_ = nullptr;
+    }
   }
 
-  void HandleHandshake(boost::system::error_code error) {
-    if (!error) {
-      socket_.async_read_some(boost::asio::buffer(data_, kMaxLength),
-                              std::bind(&Session::HandleRead, this,
-                                        std::placeholders::_1,
-                                        std::placeholders::_2));
+  void HandleHandshake(boost::system::error_code ec) {
+    --stats_.handshaking;
+    EndHandshake();
+
+    if (!ec) {
+      ++stats_.handshakes;
+      if (SSL_session_reused(socket_.native_handle())) {
+        ++stats_.resumed;
+      }
+
+      // Hand off to the data path.
+      boost::asio::dispatch(socket_.get_executor(),
+                            std::bind(&Session::DoRead, shared_from_this()));
     } else {
-      delete this;
+      ++stats_.handshake_errors;
     }
   }
 
+  void DoRead() {
+    if (coalescing_.enabled) {
+      DoReadCoalesced();
+      return;
+    }
+
+    socket_.async_read_some(boost::asio::buffer(data_, kMaxLength),
+                            std::bind(&Session::HandleRead,
+                                      shared_from_this(),
+                                      std::placeholders::_1,
+                                      std::placeholders::_2));
+  }
+
   void HandleRead(boost::system::error_code ec, std::size_t length) {
     if (!ec) {
       boost::asio::async_write(socket_,
                                boost::asio::buffer(data_, length),
-                               std::bind(&Session::HandleWrite, this,
-                                         std::placeholders::_1));
-    } else {
-      delete this;
+                               std::bind(&Session::HandleWrite,
+                                         shared_from_this(),
+                                         std::placeholders::_1,
+                                         std::placeholders::_2));
     }
+    // Otherwise, the session is destroyed with the last handler.
   }
 
-  void HandleWrite(boost::system::error_code ec) {
+  void HandleWrite(boost::system::error_code ec, std::size_t length) {
     if (!ec) {
-      socket_.async_read_some(boost::asio::buffer(data_, kMaxLength),
-                              std::bind(&Session::HandleRead, this,
-                                        std::placeholders::_1,
-                                        std::placeholders::_2));
+      stats_.bytes += length;
+      stats_.records += CountRecords(length);
+      DoRead();
+    }
+  }
+
+  // Coalescing mode.
+  // Reading goes on while a record is being written: the data is appended
+  // to |pending_| and the full (or timed out) record is swapped into
+  // |writing_buffer_| to be written. An ssl::stream allows one read and one
+  // write in progress at the same time.
+  // The read has its own buffer because the pending record may be flushed
+  // by the timer while a read is in progress.
+
+  // Read up to the free space of the pending record.
+  void DoReadCoalesced() {
+    reading_ = true;
+    socket_.async_read_some(
+        boost::asio::buffer(read_buffer_.data(),
+                            kTlsRecordSize - pending_length_),
+        std::bind(&Session::HandleReadCoalesced, shared_from_this(),
+                  std::placeholders::_1, std::placeholders::_2));
+  }
+
+  void HandleReadCoalesced(boost::system::error_code ec, std::size_t length) {
+    reading_ = false;
+
+    if (ec) {
+      // Write what's left, the session ends with the last handler.
+      closing_ = true;
+      Flush();
+      return;
+    }
+
+    if (pending_length_ == 0 && length > 0) {
+      pending_since_ = std::chrono::steady_clock::now();
+      if (!flush_timer_armed_) {
+        ScheduleFlush(pending_since_ + coalescing_.flush_delay);
+      }
+    }
+
+    std::memcpy(&pending_[pending_length_], read_buffer_.data(), length);
+    pending_length_ += length;
+
+    if (pending_length_ == kTlsRecordSize) {
+      Flush();
+    }
+
+    // When the pending record is full and can't be written yet, stop
+    // reading (back pressure); Flush() resumes it.
+    if (!reading_ && pending_length_ < kTlsRecordSize) {
+      DoReadCoalesced();
+    }
+  }
+
+  void ScheduleFlush(std::chrono::steady_clock::time_point deadline) {
+    flush_timer_armed_ = true;
+    flush_timer_.expires_at(deadline);
+    flush_timer_.async_wait(std::bind(&Session::HandleFlushTimer,
+                                      shared_from_this(),
+                                      std::placeholders::_1));
+  }
+
+  void HandleFlushTimer(boost::system::error_code ec) {
+    flush_timer_armed_ = false;
+
+    if (ec || pending_length_ == 0) {
+      return;
+    }
+
+    // The timer isn't canceled when a record is flushed because it's full,
+    // so it may have been armed for an earlier record.
+    auto deadline = pending_since_ + coalescing_.flush_delay;
+    if (std::chrono::steady_clock::now() < deadline) {
+      ScheduleFlush(deadline);
     } else {
-      delete this;
+      // If a write is in progress, HandleWriteCoalesced() flushes it.
+      Flush();
+    }
+  }
+
+  // Write the pending record unless a write is in progress.
+  void Flush() {
+    if (writing_ || pending_length_ == 0) {
+      return;
+    }
+
+    writing_ = true;
+    std::swap(pending_, writing_buffer_);
+    std::size_t length = pending_length_;
+    pending_length_ = 0;
+
+    boost::asio::async_write(socket_,
+                             boost::asio::buffer(writing_buffer_.data(),
+                                                 length),
+                             std::bind(&Session::HandleWriteCoalesced,
+                                       shared_from_this(),
+                                       std::placeholders::_1,
+                                       std::placeholders::_2));
+
+    if (!reading_ && !closing_) {
+      DoReadCoalesced();
+    }
+  }
+
+  void HandleWriteCoalesced(boost::system::error_code ec, std::size_t length) {
+    writing_ = false;
+
+    if (ec) {
+      closing_ = true;
+      flush_timer_.cancel();
+      return;
+    }
+
+    stats_.bytes += length;
+    stats_.records += CountRecords(length);
+
+    // Write the next record now if it's full, timed out or the last one.
+    if (pending_length_ == kTlsRecordSize || closing_ ||
+        (pending_length_ > 0 &&
+         std::chrono::steady_clock::now() >=
+             pending_since_ + coalescing_.flush_delay)) {
+      Flush();
     }
   }
 
-private:
   ssl_socket socket_;
+  Stats& stats_;
+
+  boost::asio::any_io_executor handshake_executor_;
+  HandshakeDone handshake_done_;
 
   enum { kMaxLength = 1024 };
   char data_[kMaxLength];
+
+  // Coalescing mode only.
+  Coalescing coalescing_;
+  boost::asio::steady_timer flush_timer_;
+  std::vector<char> read_buffer_;
+  std::vector<char> pending_;
+  std::size_t pending_length_;
+  std::chrono::steady_clock::time_point pending_since_;
+  std::vector<char> writing_buffer_;
+  bool reading_;
+  bool writing_;
+  bool flush_timer_armed_;
+  bool closing_;
+};
+
+// -----------------------------------------------------------------------------
+
+// A session running OpenSSL on the socket directly, for the kTLS and the
+// low-memory modes.
+// ssl::stream runs OpenSSL over a memory BIO pair and does the socket I/O
+// itself. So there's no socket for OpenSSL to hand the keys to (kTLS), and
+// each stream keeps two 17 KB buffers of its own plus the buffers of the BIO
+// pair, idle or not. Instead, the SSL object works on the socket directly
+// (SSL_set_fd) in non-blocking mode, and Asio only waits for the socket to be
+// ready.
+// kTLS: after the handshake, SSL_read/SSL_write go straight to the kernel if
+// the offload succeeded, or encrypt in user space if not.
+// Low memory: OpenSSL frees its record buffers whenever they are empty
+// (SSL_MODE_RELEASE_BUFFERS), and the session only allocates its buffer
+// once the socket is readable, and frees it when there's nothing more to
+// read. An idle session is then just the SSL object and a pending wait.
+class DirectSession : public std::enable_shared_from_this<DirectSession> {
+public:
+  DirectSession(tcp::socket socket, ssl::context& ssl_context, Stats& stats,
+                const boost::asio::any_io_executor& handshake_executor,
+                bool ktls, bool low_memory,
+                const HandshakeDone& handshake_done)
+      : socket_(std::move(socket)),
+        ssl_(SSL_new(ssl_context.native_handle())),
+        stats_(stats),
+        handshake_executor_(handshake_executor),
+        handshake_done_(handshake_done),
+        ktls_(ktls), low_memory_(low_memory),
+        length_(0), written_(0) {
+    ++stats_.sessions;
+
+    if (ssl_ == nullptr) {
+      throw std::runtime_error("SSL_new failed.");
+    }
+
+    socket_.non_blocking(true);
+    SSL_set_fd(ssl_, static_cast<int>(socket_.native_handle()));
+#if KTLS_SUPPORTED
+    if (ktls_) {
+      SSL_set_options(ssl_, SSL_OP_ENABLE_KTLS);
+    }
+#endif  // KTLS_SUPPORTED
+    if (low_memory_) {
+      SSL_set_mode(ssl_, SSL_MODE_RELEASE_BUFFERS);
+    }
+    SSL_set_accept_state(ssl_);
+  }
+
+  ~DirectSession() {
+    EndHandshake();
+    SSL_free(ssl_);
+    --stats_.sessions;
+  }
+
+  void Start() {
+    ++stats_.handshaking;
+    // Not on the accepting thread; as with ssl::stream, every handshake step
+    // runs in the handshake executor.
+    boost::asio::post(handshake_executor_,
+                      std::bind(&DirectSession::DoHandshake,
+                                shared_from_this()));
+  }
+
+private:
+  void EndHandshake() {
+    if (handshake_done_) {
+      handshake_done_();
+      handshake_done_ = nullptr;
+    }
+  }
+
+  void DoHandshake() {
+    int ret = SSL_do_handshake(ssl_);
+    if (ret == 1) {
+      HandleHandshake();
+      return;
+    }
+
+    // Wait() calls the handler inline on the data-path executor, so hop back
+    // to the handshake executor explicitly.
+    auto self = shared_from_this();
+    if (!Wait(ret, [self](boost::system::error_code ec) {
+          if (ec) {
+            self->FailHandshake();
+            return;
+          }
+          boost::asio::dispatch(self->handshake_executor_,
+                                std::bind(&DirectSession::DoHandshake, self));
+        })) {
+      FailHandshake();
+    }
+  }
+
+  void FailHandshake() {
+    --stats_.handshaking;
+    ++stats_.handshake_errors;
+  }
+
+  void HandleHandshake() {
+    --stats_.handshaking;
+    EndHandshake();
+    ++stats_.handshakes;
+    if (SSL_session_reused(ssl_)) {
+      ++stats_.resumed;
+    }
+
+#if KTLS_SUPPORTED
+    if (ktls_) {
+      bool send = BIO_get_ktls_send(SSL_get_wbio(ssl_));
+      bool recv = BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+      if (send && recv) {
+        ++stats_.ktls_offloaded;
+      } else if (send || recv) {
+        ++stats_.ktls_partial;
+      } else {
+        ++stats_.ktls_fallback;
+      }
+    }
+#endif  // KTLS_SUPPORTED
+
+    // Hand off to the data path.
+    boost::asio::dispatch(socket_.get_executor(),
+                          std::bind(&DirectSession::DoRead,
+                                    shared_from_this()));
+  }
+
+  void DoRead() {
+    // In the low-memory mode, wait for the socket to be readable before
+    // borrowing a buffer, unless OpenSSL has data already.
+    if (low_memory_ && !data_ && !SSL_has_pending(ssl_)) {
+      auto self = shared_from_this();
+      socket_.async_wait(tcp::socket::wait_read,
+                         [self](boost::system::error_code ec) {
+                           if (!ec) {
+                             self->ReadSome();
+                           }
+                         });
+      return;
+    }
+
+    ReadSome();
+  }
+
+  void ReadSome() {
+    if (!data_) {
+      data_.reset(new char[kMaxLength]);
+    }
+
+    int ret = SSL_read(ssl_, data_.get(), kMaxLength);
+    if (ret > 0) {
+      length_ = static_cast<std::size_t>(ret);
+      written_ = 0;
+      DoWrite();
+      return;
+    }
+
+    if (low_memory_ && SSL_get_error(ssl_, ret) == SSL_ERROR_WANT_READ) {
+      // Idle: give the buffer back until there's something to read.
+      data_.reset();
+      DoRead();
+      return;
+    }
+
+    auto self = shared_from_this();
+    Wait(ret, [self](boost::system::error_code ec) {
+      if (!ec) {
+        self->ReadSome();
+      }
+    });
+  }
+
+  void DoWrite() {
+    while (written_ < length_) {
+      int ret = SSL_write(ssl_, data_.get() + written_,
+                          static_cast<int>(length_ - written_));
+      if (ret <= 0) {
+        // NOTE: A retried SSL_write must be given the same buffer.
+        auto self = shared_from_this();
+        Wait(ret, [self](boost::system::error_code ec) {
+          if (!ec) {
+            self->DoWrite();
+          }
+        });
+        return;
+      }
+      written_ += static_cast<std::size_t>(ret);
+      stats_.records += CountRecords(static_cast<std::size_t>(ret));
+    }
+
+    stats_.bytes += length_;
+    DoRead();
+  }
+
+  // Wait until the socket is ready for what OpenSSL wants, then call
+  // |handler| with the error of the wait, if any. Return false if there's
+  // nothing to wait for (an error or the end of the connection), and so the
+  // session ends.
+  template <typename Handler>
+  bool Wait(int ret, Handler&& handler) {
+    int error = SSL_get_error(ssl_, ret);
+
+    tcp::socket::wait_type wait_type;
+    if (error == SSL_ERROR_WANT_READ) {
+      wait_type = tcp::socket::wait_read;
+    } else if (error == SSL_ERROR_WANT_WRITE) {
+      wait_type = tcp::socket::wait_write;
+    } else {
+      ERR_clear_error();
+      return false;
+    }
+
+    socket_.async_wait(wait_type, std::forward<Handler>(handler));
+    return true;
+  }
+
+  tcp::socket socket_;
+  SSL* ssl_;
+
+  Stats& stats_;
+
+  boost::asio::any_io_executor handshake_executor_;
+  HandshakeDone handshake_done_;
+
+  bool ktls_;
+  bool low_memory_;
+
+  // Allocated on the first read; in the low-memory mode, freed while idle.
+  enum { kMaxLength = 16 * 1024 };
+  std::unique_ptr<char[]> data_;
+
+  std::size_t length_;   // Bytes read, to be echoed
+  std::size_t written_;  // Bytes echoed so far
+};
+
+// -----------------------------------------------------------------------------
+
+// Admission control of the new connections, i.e., of their handshakes.
+// The accepted connections wait in a FIFO queue. The next one is started
+// (handed to |start|) as long as:
+//   - the handshakes in progress are below |max_handshakes|, and
+//   - the token bucket (|rate| per second, up to |burst|) has a token.
+// Connections waiting longer than |max_queue_delay| are shed, i.e., closed;
+// their clients have probably given up already, and a handshake for them
+// would only take the CPU from the established sessions.
+// All the state is kept in a strand, so Add() and Done() can be called from
+// any thread.
+class AdmissionControl {
+public:
+  struct Config {
+    // Max handshakes in progress; 0 for no limit.
+    std::size_t max_handshakes = 0;
+
+    // New handshakes per second; 0 for no limit.
+    double rate = 0.0;
+
+    // Size of the token bucket, i.e., the handshakes that can be started at
+    // once after an idle period. Defaults to 1/10 second of |rate|.
+    double burst = 0.0;
+
+    // 0 for no shedding.
+    std::chrono::milliseconds max_queue_delay{ 0 };
+
+    bool enabled() const {
+      return max_handshakes > 0 || rate > 0.0 ||
+             max_queue_delay.count() > 0;
+    }
+  };
+
+  typedef std::function<void(tcp::socket, const HandshakeDone&)> Start;
+
+  AdmissionControl(boost::asio::io_context& io_context, const Config& config,
+                   Stats& stats, const Start& start)
+      : strand_(boost::asio::make_strand(io_context)),
+        timer_(strand_),
+        config_(config),
+        stats_(stats),
+        start_(start),
+        handshakes_(0),
+        tokens_(0.0),
+        timer_armed_(false) {
+    if (config_.burst <= 0.0) {
+      config_.burst = (std::max)(1.0, config_.rate / 10);
+    }
+    tokens_ = config_.burst;
+    refill_time_ = Clock::now();
+  }
+
+  // Queue a new connection.
+  void Add(tcp::socket socket) {
+    // The socket is moved into the handler through a shared_ptr since
+    // std::function (of std::bind) needs a copyable handler.
+    auto p = std::make_shared<tcp::socket>(std::move(socket));
+    boost::asio::post(strand_, [this, p]() {
+      queue_.push_back(Waiting{ std::move(*p), Clock::now() });
+      ++stats_.queued;
+      Admit();
+    });
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Waiting {
+    tcp::socket socket;
+    Clock::time_point time;  // Since when
+  };
+
+  void Done() {
+    boost::asio::post(strand_, [this]() {
+      --handshakes_;
+      Admit();
+    });
+  }
+
+  void Admit() {
+    Clock::time_point now = Clock::now();
+
+    Shed(now);
+
+    while (!queue_.empty()) {
+      if (config_.max_handshakes > 0 &&
+          handshakes_ >= config_.max_handshakes) {
+        break;  // Until Done()
+      }
+
+      if (config_.rate > 0.0) {
+        Refill(now);
+        if (tokens_ < 1.0) {
+          ScheduleAdmit(now + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double>(
+                                      (1.0 - tokens_) / config_.rate)));
+          break;
+        }
+        tokens_ -= 1.0;
+      }
+
+      Waiting waiting = std::move(queue_.front());
+      queue_.pop_front();
+      --stats_.queued;
+
+      UpdateMaxQueueDelay(now - waiting.time);
+
+      ++handshakes_;
+      start_(std::move(waiting.socket),
+             std::bind(&AdmissionControl::Done, this));
+    }
+
+    // Shed the oldest connection on time even if nothing else happens
+    // meanwhile, e.g., while no handshake completes at the cap.
+    if (!queue_.empty() && config_.max_queue_delay.count() > 0) {
+      ScheduleAdmit(queue_.front().time + config_.max_queue_delay);
+    }
+  }
+
+  void Shed(Clock::time_point now) {
+    if (config_.max_queue_delay.count() <= 0) {
+      return;
+    }
+
+    while (!queue_.empty() &&
+           now - queue_.front().time > config_.max_queue_delay) {
+      UpdateMaxQueueDelay(now - queue_.front().time);
+
+      boost::system::error_code ec;
+      queue_.front().socket.close(ec);
+      queue_.pop_front();
+      --stats_.queued;
+      ++stats_.shed;
+    }
+  }
+
+  void Refill(Clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - refill_time_;
+    tokens_ = (std::min)(config_.burst,
+                         tokens_ + elapsed.count() * config_.rate);
+    refill_time_ = now;
+  }
+
+  // Admit() again at |time|, unless it's armed for earlier already.
+  void ScheduleAdmit(Clock::time_point time) {
+    if (timer_armed_ && timer_.expiry() <= time) {
+      return;
+    }
+
+    // Re-arming cancels the pending wait, whose handler then leaves
+    // |timer_armed_| alone.
+    timer_armed_ = true;
+    timer_.expires_at(time);
+    timer_.async_wait([this](boost::system::error_code ec) {
+      if (!ec) {
+        timer_armed_ = false;
+        Admit();
+      }
+    });
+  }
+
+  void UpdateMaxQueueDelay(Clock::duration delay) {
+    std::size_t us = static_cast<std::size_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(delay).count());
+    // The stats are also reset from the stats thread.
+    std::size_t max = stats_.max_queue_delay_us.load();
+    while (us > max &&
+           !stats_.max_queue_delay_us.compare_exchange_weak(max, us)) {
+    }
+  }
+
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::steady_timer timer_;
+
+  Config config_;
+  Stats& stats_;
+  Start start_;
+
+  std::deque<Waiting> queue_;
+
+  std::size_t handshakes_;  // In progress
+
+  // Token bucket.
+  double tokens_;
+  Clock::time_point refill_time_;
+  bool timer_armed_;
 };
 
 // -----------------------------------------------------------------------------
 
 class Server {
 public:
-  Server(boost::asio::io_context& io_context, unsigned short port)
+  struct Config {
+    // Directory of server.pem and dh2048.pem.
+    std::string cert_dir;
+
+    // See utility::ApplyTlsProfile().
+    std::string tls_profile = "compat";
+
+    // Server side session cache. Size 0 disables it.
+    long session_cache_size = 20 * 1024;
+    long session_ttl_seconds = 300;
+
+    // Stateless session tickets.
+    bool tickets = true;
+    // Interval to rotate the ticket keys. A ticket is accepted for two
+    // intervals at most.
+    int ticket_rotation_seconds = 3600;
+
+    // Offload the record encryption to the kernel (kTLS), if supported.
+    bool ktls = false;
+
+    // Free the buffers of the idle sessions.
+    bool low_memory = false;
+
+    // Not applied to the kTLS and low-memory sessions, which always read up
+    // to a record.
+    Coalescing coalescing;
+
+    AdmissionControl::Config admission;
+  };
+
+  // Sessions are run by |session_contexts| round-robin, or by strands of
+  // |io_context| if it's empty.
+  Server(boost::asio::io_context& io_context, unsigned short port,
+         const Config& config,
+         std::vector<boost::asio::io_context*> session_contexts,
+         Stats& stats)
       : io_context_(io_context),
         acceptor_(io_context, tcp::endpoint(tcp::v4(), port)),
-        ssl_context_(ssl::context::sslv23) {
+        ssl_context_(ssl::context::sslv23),
+        config_(config),
+        session_contexts_(std::move(session_contexts)),
+        next_context_(0),
+        handshake_context_(nullptr),
+        ticket_timer_(io_context),
+        stats_(stats) {
     ssl_context_.set_options(ssl::context::default_workarounds |
                              ssl::context::no_sslv2 |
                              ssl::context::single_dh_use);
@@ -84,13 +845,22 @@ public:
     //   - https://stackoverflow.com/a/13986949/6825348
     ssl_context_.set_password_callback(std::bind(&Server::GetPassword, this));
 
-    // TODO
-    std::string key = "D:\\github\\boost-asio-study\\src\\ssl\\server.pem";
-    std::string dh_file = "D:\\github\\boost-asio-study\\src\\ssl\\dh2048.pem";
+    std::string key = config_.cert_dir + "server.pem";
+    std::string dh_file = config_.cert_dir + "dh2048.pem";
 
     ssl_context_.use_certificate_chain_file(key);
     ssl_context_.use_private_key_file(key, ssl::context::pem);
-    ssl_context_.use_tmp_dh_file(dh_file);
+
+    utility::ApplyTlsProfile(ssl_context_, config_.tls_profile, dh_file);
+
+    SetUpResumption();
+
+    if (config_.admission.enabled()) {
+      admission_.reset(new AdmissionControl(
+          io_context_, config_.admission, stats_,
+          std::bind(&Server::StartSession, this, std::placeholders::_1,
+                    std::placeholders::_2)));
+    }
 
     StartAccept();
   }
@@ -99,44 +869,359 @@ public:
     return "test";
   }
 
+  // Run the handshakes in |handshake_context| instead of the session's
+  // executor.
+  void set_handshake_context(boost::asio::io_context* handshake_context) {
+    handshake_context_ = handshake_context;
+  }
+
+  const Stats& stats() const { return stats_; }
+  Stats& stats() { return stats_; }
+
+  bool admission_control() const { return admission_ != nullptr; }
+
+  // E.g., "cache hits/misses: 10/2, ticket hits/renewals/misses: 8/0/1".
+  void PrintResumptionStats(std::ostream& os) {
+    utility::SessionCacheStats cache = utility::GetSessionCacheStats(
+        ssl_context_);
+
+    os << "cache hits/misses: " << cache.hits << "/" << cache.misses;
+    if (ticket_key_ring_) {
+      os << ", ticket hits/renewals/misses: " << ticket_key_ring_->hits()
+         << "/" << ticket_key_ring_->renewals() << "/"
+         << ticket_key_ring_->misses();
+    }
+  }
+
+private:
+  void SetUpResumption() {
+    if (config_.session_cache_size <= 0 && !config_.tickets) {
+      utility::DisableSessionResumption(ssl_context_);
+      return;
+    }
+
+    if (config_.session_cache_size > 0) {
+      utility::EnableServerSessionCache(ssl_context_,
+                                        config_.session_cache_size,
+                                        config_.session_ttl_seconds);
+    } else {
+      SSL_CTX_set_session_cache_mode(ssl_context_.native_handle(),
+                                     SSL_SESS_CACHE_OFF);
+    }
+
+    if (config_.tickets) {
+      ticket_key_ring_.reset(new utility::TicketKeyRing(ssl_context_));
+      ScheduleTicketRotation();
+    } else {
+      SSL_CTX_set_options(ssl_context_.native_handle(), SSL_OP_NO_TICKET);
+    }
+  }
+
+  void ScheduleTicketRotation() {
+    ticket_timer_.expires_after(
+        std::chrono::seconds(config_.ticket_rotation_seconds));
+    ticket_timer_.async_wait([this](boost::system::error_code ec) {
+      if (!ec) {
+        ticket_key_ring_->Rotate();
+        ScheduleTicketRotation();
+      }
+    });
+  }
+
   void StartAccept() {
-    Session* new_session = new Session(io_context_, ssl_context_);
-    acceptor_.async_accept(new_session->socket(),
-                           std::bind(&Server::HandleAccept, this, new_session,
-                                     std::placeholders::_1));
+    auto handler = std::bind(&Server::HandleAccept, this,
+                             std::placeholders::_1, std::placeholders::_2);
+
+    if (session_contexts_.empty()) {
+      // The accepted socket uses a new strand as its executor.
+      acceptor_.async_accept(boost::asio::make_strand(io_context_), handler);
+    } else {
+      boost::asio::io_context& io_context =
+          *session_contexts_[next_context_++ % session_contexts_.size()];
+      acceptor_.async_accept(io_context, handler);
+    }
   }
 
-  void HandleAccept(Session* new_session, boost::system::error_code ec) {
+  void HandleAccept(boost::system::error_code ec, tcp::socket socket) {
     if (!ec) {
-      new_session->Start();
-    } else {
-      delete new_session;
+      if (admission_) {
+        admission_->Add(std::move(socket));
+      } else {
+        StartSession(std::move(socket), HandshakeDone());
+      }
     }
 
     StartAccept();
   }
 
-private:
+  void StartSession(tcp::socket socket, const HandshakeDone& handshake_done) {
+    boost::asio::any_io_executor handshake_executor =
+        handshake_context_ != nullptr ? handshake_context_->get_executor()
+                                      : socket.get_executor();
+
+    if (config_.ktls || config_.low_memory) {
+      std::make_shared<DirectSession>(std::move(socket), ssl_context_, stats_,
+                                      handshake_executor, config_.ktls,
+                                      config_.low_memory,
+                                      handshake_done)->Start();
+      return;
+    }
+
+    std::make_shared<Session>(std::move(socket), ssl_context_, stats_,
+                              handshake_executor, config_.coalescing,
+                              handshake_done)->Start();
+  }
+
   boost::asio::io_context& io_context_;
   tcp::acceptor acceptor_;
   ssl::context ssl_context_;
+
+  Config config_;
+
+  std::vector<boost::asio::io_context*> session_contexts_;
+  std::size_t next_context_;
+
+  boost::asio::io_context* handshake_context_;
+
+  std::unique_ptr<utility::TicketKeyRing> ticket_key_ring_;
+  boost::asio::steady_timer ticket_timer_;
+
+  Stats& stats_;
+
+  std::unique_ptr<AdmissionControl> admission_;
 };
 
 // -----------------------------------------------------------------------------
 
+// Print the stats every second.
+class StatsPrinter {
+public:
+  StatsPrinter(boost::asio::io_context& io_context, Server& server)
+      : timer_(io_context), server_(server), stats_(server.stats()),
+        handshakes_(0), resumed_(0), bytes_(0), records_(0),
+        cpu_seconds_(utility::GetCpuSeconds()) {
+    Schedule();
+  }
+
+private:
+  void Schedule() {
+    timer_.expires_after(std::chrono::seconds(1));
+    timer_.async_wait(std::bind(&StatsPrinter::Print, this,
+                                std::placeholders::_1));
+  }
+
+  void Print(boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+
+    std::size_t handshakes = stats_.handshakes;
+    std::size_t resumed = stats_.resumed;
+    std::size_t bytes = stats_.bytes;
+    std::size_t records = stats_.records;
+    double cpu_seconds = utility::GetCpuSeconds();
+
+    // CPU seconds per GB echoed.
+    double cpu_per_gb = 0.0;
+    if (bytes > bytes_) {
+      cpu_per_gb = (cpu_seconds - cpu_seconds_) / ((bytes - bytes_) / 1e9);
+    }
+
+    std::cout << "sessions: " << stats_.sessions
+              << ", handshaking: " << stats_.handshaking
+              << ", handshakes/s: " << (handshakes - handshakes_)
+              << " (resumed: " << (resumed - resumed_) << ")"
+              << ", echo MB/s: " << (bytes - bytes_) / 1e6
+              << ", records/s: " << (records - records_)
+              << ", CPU: " << (cpu_seconds - cpu_seconds_) * 100 << "%"
+              << ", CPU s/GB: " << cpu_per_gb << ", ";
+    server_.PrintResumptionStats(std::cout);
+    if (server_.admission_control()) {
+      std::cout << ", queued: " << stats_.queued
+                << " (max delay: " << stats_.max_queue_delay_us.exchange(0) / 1e3
+                << " ms), shed: " << stats_.shed;
+    }
+    if (stats_.ktls_offloaded + stats_.ktls_partial + stats_.ktls_fallback >
+        0) {
+      std::cout << ", kTLS offloaded/partial/fallback: "
+                << stats_.ktls_offloaded << "/" << stats_.ktls_partial << "/"
+                << stats_.ktls_fallback;
+    }
+    std::cout << std::endl;
+
+    handshakes_ = handshakes;
+    resumed_ = resumed;
+    bytes_ = bytes;
+    records_ = records;
+    cpu_seconds_ = cpu_seconds;
+
+    Schedule();
+  }
+
+  boost::asio::steady_timer timer_;
+  Server& server_;
+  Stats& stats_;
+  std::size_t handshakes_;
+  std::size_t resumed_;
+  std::size_t bytes_;
+  std::size_t records_;
+  double cpu_seconds_;
+};
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " <port> [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --threads=<n>     Default: #cores" << std::endl;
+  std::cout << "    --per-core        One io_context per thread." << std::endl;
+  std::cout << "    --handshake-threads=<n>" << std::endl;
+  std::cout << "                      Run handshakes in a separate pool."
+            << std::endl;
+  std::cout << "    --tls-profile=<compat|ffdhe|ecdhe|tls13>" << std::endl;
+  std::cout << "    --session-cache=<n>  Session cache size, 0 to disable."
+            << std::endl;
+  std::cout << "    --session-ttl=<seconds>" << std::endl;
+  std::cout << "    --no-tickets      Disable session tickets." << std::endl;
+  std::cout << "    --ticket-rotation=<seconds>" << std::endl;
+  std::cout << "    --ktls            Kernel TLS offload (Linux)." << std::endl;
+  std::cout << "    --low-memory      Free the buffers of idle sessions."
+            << std::endl;
+  std::cout << "    --coalesce        Write full 16 KB TLS records." << std::endl;
+  std::cout << "    --flush-us=<n>    Coalescing flush deadline (default: 200)."
+            << std::endl;
+  std::cout << "    --max-handshakes=<n>" << std::endl;
+  std::cout << "                      Cap of the handshakes in progress."
+            << std::endl;
+  std::cout << "    --handshake-rate=<n>" << std::endl;
+  std::cout << "                      New handshakes per second." << std::endl;
+  std::cout << "    --handshake-burst=<n>" << std::endl;
+  std::cout << "                      Default: rate / 10" << std::endl;
+  std::cout << "    --max-queue-delay-ms=<n>" << std::endl;
+  std::cout << "                      Shed connections queued longer."
+            << std::endl;
+  std::cout << "    --stats           Print stats every second." << std::endl;
+  std::cout << "    --cert-dir=<dir>  Directory of server.pem and dh2048.pem."
+            << std::endl;
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cout << "Usage: " << argv[0] << " <host>" << std::endl;
+  utility::Options options(argc, argv);
+
+  if (options.args().size() != 1) {
+    Help(argv[0]);
     return 1;
   }
 
+  unsigned short port = std::atoi(options.args()[0].c_str());
+
+  std::size_t threads = std::thread::hardware_concurrency();
+  threads = options.GetInt("threads", threads > 0 ? threads : 1);
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  bool per_core = options.Has("per-core");
+
+  // For tens of thousands of connections.
+  utility::RaiseOpenFileLimit();
+
+  std::size_t handshake_threads = options.GetInt("handshake-threads", 0);
+
   try {
-    boost::asio::io_context io_context;
+    // The acceptor (and the stats printer) always runs in this io_context.
+    // In the thread pool mode, the sessions run in it, too.
+    boost::asio::io_context io_context(per_core ? 1 : static_cast<int>(threads));
+
+    // In the per-core mode, the sessions run in their own io_contexts.
+    std::vector<std::unique_ptr<boost::asio::io_context>> session_contexts;
+    std::vector<boost::asio::io_context*> session_context_ptrs;
+
+    if (per_core) {
+      for (std::size_t i = 0; i < threads; ++i) {
+        session_contexts.emplace_back(new boost::asio::io_context(1));
+        session_context_ptrs.push_back(session_contexts.back().get());
+      }
+    }
 
-    Server server(io_context, std::atoi(argv[1]));
+    // The pool for the handshakes, if any.
+    boost::asio::io_context handshake_context(
+        static_cast<int>(handshake_threads > 0 ? handshake_threads : 1));
+
+    Stats stats;
+
+    Server::Config config;
+    config.cert_dir = options.Get("cert-dir", SSL_CERT_DIR);
+    config.tls_profile = options.Get("tls-profile", config.tls_profile);
+    config.session_cache_size =
+        options.GetInt("session-cache", config.session_cache_size);
+    config.session_ttl_seconds =
+        options.GetInt("session-ttl", config.session_ttl_seconds);
+    config.tickets = !options.Has("no-tickets");
+    config.ticket_rotation_seconds =
+        options.GetInt("ticket-rotation", config.ticket_rotation_seconds);
+    config.ktls = options.Has("ktls");
+    config.low_memory = options.Has("low-memory");
+    config.admission.max_handshakes = options.GetInt("max-handshakes", 0);
+    config.admission.rate = options.GetDouble("handshake-rate", 0.0);
+    config.admission.burst = options.GetDouble("handshake-burst", 0.0);
+    config.admission.max_queue_delay =
+        std::chrono::milliseconds(options.GetInt("max-queue-delay-ms", 0));
+    config.coalescing.enabled = options.Has("coalesce");
+    config.coalescing.flush_delay = std::chrono::microseconds(
+        options.GetInt("flush-us", static_cast<int>(
+            config.coalescing.flush_delay.count())));
+
+#if !KTLS_SUPPORTED
+    if (config.ktls) {
+      std::cerr << "kTLS is not supported by this build, ignored."
+                << std::endl;
+      config.ktls = false;
+    }
+#endif  // !KTLS_SUPPORTED
+
+    Server server(io_context, port, config, session_context_ptrs, stats);
+
+    if (handshake_threads > 0) {
+      server.set_handshake_context(&handshake_context);
+    }
+
+    std::unique_ptr<StatsPrinter> stats_printer;
+    if (options.Has("stats")) {
+      stats_printer.reset(new StatsPrinter(io_context, server));
+    }
+
+    std::vector<std::thread> thread_pool;
+
+    for (std::size_t i = 0; i < handshake_threads; ++i) {
+      thread_pool.emplace_back([&handshake_context]() {
+        auto work = boost::asio::make_work_guard(handshake_context);
+        handshake_context.run();
+      });
+    }
+
+    if (per_core) {
+      for (auto& session_context : session_contexts) {
+        boost::asio::io_context* p = session_context.get();
+        thread_pool.emplace_back([p]() {
+          // Keep running even when there's no session.
+          auto work = boost::asio::make_work_guard(*p);
+          p->run();
+        });
+      }
+    } else {
+      // The main thread is one of the pool.
+      for (std::size_t i = 1; i < threads; ++i) {
+        thread_pool.emplace_back([&io_context]() { io_context.run(); });
+      }
+    }
 
     io_context.run();
 
+    for (auto& t : thread_pool) {
+      t.join();
+    }
+
   } catch (const std::exception& e) {
     std::cerr << "Exception: " << e.what() << "\n";
   }
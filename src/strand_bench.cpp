@@ -0,0 +1,283 @@
+// Strand contention benchmark.
+// Compares the serialization models for many sessions:
+//   - io_context::strand, the legacy strand of |strand|;
+//   - asio::strand<io_context::executor_type>, made by make_strand() as in
+//     |strand2|;
+//   - io_context per thread: each "strand" is pinned to the io_context of
+//     one thread (strand index % threads), which runs its handlers in order
+//     without any strand at all.
+// A fixed number of handlers (--inflight) hop from strand to strand: each one,
+// when run, posts itself to another random strand, until --handlers have
+// run in total. Reports the throughput and the queueing latency of the
+// handlers, i.e., from post to run.
+// NOTE: io_context::strand shares a fixed pool of implementations (193 by
+// default, see BOOST_ASIO_STRAND_IMPLEMENTATIONS), so thousands of them
+// serialize with each other.
+// E.g.,
+//   $ strand_bench --strands=1,16,10000 --threads=1,2,4 --handlers=2000000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/strand.hpp"
+
+#include "utility.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The latency samples of the current thread.
+thread_local std::vector<double>* t_samples = nullptr;
+
+// -----------------------------------------------------------------------------
+
+struct Result {
+  double handlers_per_second = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+};
+
+// Posts handlers to the strands (any executors) until the total is reached,
+// then stops the io_contexts.
+template <typename Executor>
+class Bench {
+public:
+  Bench(std::vector<Executor> strands,
+        std::vector<boost::asio::io_context*> io_contexts,
+        std::size_t handlers)
+      : strands_(std::move(strands)), io_contexts_(std::move(io_contexts)),
+        handlers_(handlers), count_(0) {
+  }
+
+  void Start(std::size_t inflight) {
+    for (std::size_t i = 0; i < inflight; ++i) {
+      Post(Token{ this, static_cast<std::uint32_t>(i * 2654435761u + 1),
+                  Clock::time_point() });
+    }
+  }
+
+private:
+  struct Token {
+    void operator()() { bench->OnRun(*this); }
+
+    Bench* bench;
+    std::uint32_t random;  // xorshift32 state
+    Clock::time_point posted;
+  };
+
+  void Post(Token token) {
+    // Next random strand.
+    token.random ^= token.random << 13;
+    token.random ^= token.random >> 17;
+    token.random ^= token.random << 5;
+    Executor& strand = strands_[token.random % strands_.size()];
+
+    token.posted = Clock::now();
+    boost::asio::post(strand, token);
+  }
+
+  void OnRun(Token& token) {
+    Clock::time_point now = Clock::now();
+    t_samples->push_back(
+        std::chrono::duration<double, std::micro>(now - token.posted).count());
+
+    std::size_t count = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count < handlers_) {
+      Post(token);
+    } else if (count == handlers_) {
+      for (boost::asio::io_context* io_context : io_contexts_) {
+        io_context->stop();
+      }
+    }
+  }
+
+  std::vector<Executor> strands_;
+  std::vector<boost::asio::io_context*> io_contexts_;
+  std::size_t handlers_;
+  std::atomic<std::size_t> count_;
+};
+
+// Run the io_contexts, |threads| threads in total, and collect the samples.
+template <typename Executor>
+Result Run(Bench<Executor>& bench,
+           const std::vector<boost::asio::io_context*>& io_contexts,
+           std::size_t threads, std::size_t handlers, std::size_t inflight) {
+  std::vector<std::vector<double>> samples(threads);
+  for (std::vector<double>& thread_samples : samples) {
+    thread_samples.reserve(handlers / threads + inflight);
+  }
+
+  Clock::time_point start = Clock::now();
+  bench.Start(inflight);
+
+  std::vector<std::thread> loops;
+  for (std::size_t i = 0; i < threads; ++i) {
+    boost::asio::io_context* io_context = io_contexts[i % io_contexts.size()];
+    std::vector<double>* thread_samples = &samples[i];
+    loops.emplace_back([io_context, thread_samples]() {
+      t_samples = thread_samples;
+      io_context->run();
+    });
+  }
+  for (std::thread& loop : loops) {
+    loop.join();
+  }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  std::vector<double> all;
+  all.reserve(handlers + inflight);
+  for (const std::vector<double>& thread_samples : samples) {
+    all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+  }
+  std::sort(all.begin(), all.end());
+
+  Result result;
+  result.handlers_per_second = all.size() / elapsed.count();
+  result.p50_us = utility::Percentile(all, 0.5);
+  result.p99_us = utility::Percentile(all, 0.99);
+  return result;
+}
+
+Result RunLegacyStrands(std::size_t strands, std::size_t threads,
+                        std::size_t handlers, std::size_t inflight) {
+  boost::asio::io_context io_context(static_cast<int>(threads));
+
+  std::vector<boost::asio::io_context::strand> executors;
+  for (std::size_t i = 0; i < strands; ++i) {
+    executors.emplace_back(io_context);
+  }
+
+  Bench<boost::asio::io_context::strand> bench(std::move(executors),
+                                               { &io_context }, handlers);
+  return Run(bench, { &io_context }, threads, handlers, inflight);
+}
+
+Result RunStrands(std::size_t strands, std::size_t threads,
+                  std::size_t handlers, std::size_t inflight) {
+  typedef boost::asio::strand<boost::asio::io_context::executor_type> Strand;
+
+  boost::asio::io_context io_context(static_cast<int>(threads));
+
+  std::vector<Strand> executors;
+  for (std::size_t i = 0; i < strands; ++i) {
+    executors.push_back(boost::asio::make_strand(io_context));
+  }
+
+  Bench<Strand> bench(std::move(executors), { &io_context }, handlers);
+  return Run(bench, { &io_context }, threads, handlers, inflight);
+}
+
+Result RunContextPerThread(std::size_t strands, std::size_t threads,
+                           std::size_t handlers, std::size_t inflight) {
+  typedef boost::asio::io_context::executor_type Executor;
+
+  std::vector<std::unique_ptr<boost::asio::io_context>> contexts;
+  std::vector<boost::asio::io_context*> io_contexts;
+  for (std::size_t i = 0; i < threads; ++i) {
+    contexts.emplace_back(new boost::asio::io_context(1));
+    io_contexts.push_back(contexts.back().get());
+  }
+
+  // Don't let a loop return while the handlers are all elsewhere.
+  std::vector<boost::asio::executor_work_guard<Executor>> work;
+  for (boost::asio::io_context* io_context : io_contexts) {
+    work.push_back(boost::asio::make_work_guard(*io_context));
+  }
+
+  std::vector<Executor> executors;
+  for (std::size_t i = 0; i < strands; ++i) {
+    executors.push_back(io_contexts[i % threads]->get_executor());
+  }
+
+  Bench<Executor> bench(std::move(executors), io_contexts, handlers);
+  return Run(bench, io_contexts, threads, handlers, inflight);
+}
+
+void Print(const std::string& name, const Result& result) {
+  std::cout << "  " << std::left << std::setw(20) << name << std::right
+            << std::fixed << std::setprecision(2) << std::setw(6)
+            << result.handlers_per_second / 1e6 << " M handlers/s"
+            << std::setprecision(1)
+            << ", latency p50: " << std::setw(7) << result.p50_us << " us"
+            << ", p99: " << std::setw(8) << result.p99_us << " us"
+            << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::size_t> ParseList(const std::string& str) {
+  std::vector<std::size_t> list;
+  std::istringstream stream(str);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::size_t n = std::strtoul(item.c_str(), nullptr, 10);
+    if (n > 0) {
+      list.push_back(n);
+    }
+  }
+  return list;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --strands=<n,...>   Default: 1,16,10000" << std::endl;
+  std::cout << "    --threads=<n,...>   Default: 1,2,4" << std::endl;
+  std::cout << "    --handlers=<n>      Per run. Default: 2000000"
+            << std::endl;
+  std::cout << "    --inflight=<n>      Handlers hopping. Default: 64"
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::vector<std::size_t> strands_list =
+      ParseList(options.Get("strands", "1,16,10000"));
+  std::vector<std::size_t> threads_list =
+      ParseList(options.Get("threads", "1,2,4"));
+  std::size_t handlers = options.GetInt("handlers", 2000000);
+  std::size_t inflight = options.GetInt("inflight", 64);
+
+  if (strands_list.empty() || threads_list.empty() || handlers == 0 ||
+      inflight == 0) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::cout << "CPUs: " << std::thread::hardware_concurrency()
+            << ", handlers: " << handlers << ", inflight: " << inflight
+            << std::endl;
+
+  for (std::size_t strands : strands_list) {
+    for (std::size_t threads : threads_list) {
+      std::cout << "strands: " << strands << ", threads: " << threads
+                << std::endl;
+      Print("io_context::strand",
+            RunLegacyStrands(strands, threads, handlers, inflight));
+      Print("asio::strand", RunStrands(strands, threads, handlers, inflight));
+      Print("io_context/thread",
+            RunContextPerThread(strands, threads, handlers, inflight));
+    }
+  }
+
+  return 0;
+}
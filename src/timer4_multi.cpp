@@ -1,4 +1,5 @@
 // Wait multiple timers asynchronously.
+// See |timer5_threaded| --wheel for the same with utility::WheelTimer.
 
 #include <chrono>
 #include <iostream>
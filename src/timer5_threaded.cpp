@@ -1,39 +1,235 @@
 // Wait multiple timers asynchronously.
-// At the same time, run the loop in two threads.
+// At the same time, run the loop in multiple threads.
+//
+// Measures the timer accuracy: N timers with random deadlines are waited by
+// the loop running in M threads; for each timer, the actual minus the
+// intended expiry time (how late it completes) is recorded by the thread
+// running its handler. The percentiles are reported per thread.
+// With --load=<n>, n more threads keep the CPUs busy in the background.
+// With --low-latency, the threads run the loop with utility::LowLatencyRunner
+// instead of io_context::run(), spinning near the deadlines of the timers.
+// With --wheel, the timers are utility::WheelTimer (timer_wheel.h) instead of
+// steady_timer, the same pattern with a timing wheel; add --slack-ms=<ms> to
+// let their expirations coalesce (see |timer_slack_bench| for the wakeups
+// saved).
+// E.g.,
+//   $ timer5_threaded --timers=1000 --threads=2
+//   $ timer5_threaded --timers=1000 --threads=2 --load=2
+//   $ timer5_threaded --timers=1000 --threads=2 --low-latency --spin-us=200
+//   $ timer5_threaded --timers=100000 --threads=2 --wheel --slack-ms=10
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <mutex>
+#include <random>
 #include <thread>
+#include <vector>
 
 #include "boost/asio/io_context.hpp"
 #include "boost/asio/steady_timer.hpp"
 
-std::mutex g_io_mutex;
+#include "low_latency_runner.h"
+#include "timer_wheel.h"
+#include "utility.h"
 
-void Print(boost::system::error_code ec) {
-  std::lock_guard<std::mutex> lock(g_io_mutex);
+typedef std::chrono::steady_clock Clock;
 
-  std::cout << "Hello, World!";
-  std::cout << " (" << std::this_thread::get_id() << ")" << std::endl;
+// How late the timers complete (us), per thread running the loop.
+class Recorder {
+public:
+  void Add(Clock::duration late) {
+    double us = std::chrono::duration<double, std::micro>(late).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_[std::this_thread::get_id()].push_back(us);
+  }
+
+  void Print() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<double> all;
+    std::size_t index = 0;
+    for (auto& pair : samples_) {
+      Print("thread " + std::to_string(index++), pair.second);
+      all.insert(all.end(), pair.second.begin(), pair.second.end());
+    }
+    Print("all", all);
+  }
+
+private:
+  static void Print(const std::string& name, std::vector<double>& samples) {
+    std::sort(samples.begin(), samples.end());
+
+    std::cout << "  " << std::left << std::setw(9) << name << std::right
+              << "timers: " << std::setw(6) << samples.size()
+              << std::fixed << std::setprecision(1);
+    const double kPercentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const char* kNames[] = { "p50", "p90", "p99", "p99.9" };
+    for (std::size_t i = 0; i < 4; ++i) {
+      std::cout << ", " << kNames[i] << ": " << std::setw(7)
+                << utility::Percentile(samples, kPercentiles[i]);
+    }
+    std::cout << ", max: " << std::setw(8)
+              << (samples.empty() ? 0.0 : samples.back()) << " (us)"
+              << std::endl;
+  }
+
+  std::mutex mutex_;
+  std::map<std::thread::id, std::vector<double>> samples_;
+};
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --timers=<n>     Default: 1000" << std::endl;
+  std::cout << "    --threads=<n>    Threads running the loop. Default: 2"
+            << std::endl;
+  std::cout << "    --max-ms=<ms>    Deadlines in 1 ~ max ms. Default: 3000"
+            << std::endl;
+  std::cout << "    --load=<n>       Busy threads in the background."
+            << " Default: 0" << std::endl;
+  std::cout << "    --low-latency    Run the loop with LowLatencyRunner."
+            << std::endl;
+  std::cout << "    --spin-us=<us>   Spin before the deadlines. Default: 200"
+            << std::endl;
+  std::cout << "    --yield          Yield the CPU while spinning."
+            << std::endl;
+  std::cout << "    --wheel          Use utility::WheelTimer." << std::endl;
+  std::cout << "    --slack-ms=<ms>  Slack of the wheel timers. Default: 0"
+            << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::size_t count = options.GetInt("timers", 1000);
+  std::size_t threads = options.GetInt("threads", 2);
+  long max_ms = options.GetInt("max-ms", 3000);
+  std::size_t load = options.GetInt("load", 0);
+  bool low_latency = options.Has("low-latency");
+  bool wheel = options.Has("wheel");
+  std::chrono::milliseconds slack(options.GetInt("slack-ms", 0));
+
+  if (count == 0 || threads == 0 || max_ms < 1 || slack.count() < 0) {
+    Help(argv[0]);
+    return 1;
+  }
+
   boost::asio::io_context io_context;
 
-  boost::asio::steady_timer timer1{ io_context, std::chrono::seconds(3) };
-  boost::asio::steady_timer timer2{ io_context, std::chrono::seconds(1) };
+  // Spinning burns more CPU the earlier it starts.
+  utility::LowLatencyRunner::Options runner_options;
+  runner_options.spin_before =
+      std::chrono::microseconds(options.GetInt("spin-us", 200));
+  runner_options.yield = options.Has("yield");
+  utility::LowLatencyRunner runner{ io_context, runner_options };
+
+  Recorder recorder;
+
+  std::mt19937 random(static_cast<std::mt19937::result_type>(count));
+  std::uniform_int_distribution<long> deadline_us(1000, max_ms * 1000);
+
+  // Only one of them is used.
+  std::deque<boost::asio::steady_timer> timers;
+  std::deque<utility::WheelTimer> wheel_timers;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    std::chrono::microseconds deadline(deadline_us(random));
+    Clock::time_point expiry;
+
+    if (wheel) {
+      wheel_timers.emplace_back(io_context);
+      utility::WheelTimer& timer = wheel_timers.back();
+      timer.expires_after(deadline, slack);
+
+      // How late from the deadline, so including the slack.
+      timer.async_wait([&recorder, &timer](boost::system::error_code ec) {
+        if (!ec) {
+          recorder.Add(Clock::now() - timer.expiry());
+        }
+      });
+      expiry = timer.expiry();
+    } else {
+      timers.emplace_back(io_context, deadline);
+      boost::asio::steady_timer& timer = timers.back();
+
+      timer.async_wait([&recorder, &timer](boost::system::error_code ec) {
+        if (!ec) {
+          recorder.Add(Clock::now() - timer.expiry());
+        }
+      });
+      expiry = timer.expiry();
+    }
+
+    if (low_latency) {
+      runner.Expect(expiry);
+    }
+  }
+
+  // Keep the CPUs busy until the timers are done.
+  std::atomic<bool> done{ false };
+  std::vector<std::thread> busy_threads;
+  for (std::size_t i = 0; i < load; ++i) {
+    busy_threads.emplace_back([&done]() {
+      volatile std::size_t n = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        n = n + 1;
+      }
+    });
+  }
+
+  double cpu = utility::GetCpuSeconds();
+  Clock::time_point start = Clock::now();
+
+  // Run the loop in M threads.
+  std::vector<std::thread> loops;
+  for (std::size_t i = 0; i < threads; ++i) {
+    if (low_latency) {
+      loops.emplace_back(&utility::LowLatencyRunner::Run, &runner);
+    } else {
+      loops.emplace_back(&boost::asio::io_context::run, &io_context);
+    }
+  }
+
+  // Wait for the M loops to end.
+  for (std::thread& loop : loops) {
+    loop.join();
+  }
+
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  cpu = utility::GetCpuSeconds() - cpu;
 
-  timer1.async_wait(&Print);
-  timer2.async_wait(&Print);
+  done = true;
+  for (std::thread& busy_thread : busy_threads) {
+    busy_thread.join();
+  }
 
-  // Run the loop in 2 threads.
-  std::thread t1{ &boost::asio::io_context::run, &io_context };
-  std::thread t2{ &boost::asio::io_context::run, &io_context };
+  std::cout << "timers: " << count << ", threads: " << threads
+            << ", load: " << load
+            << (low_latency ? ", low latency" : "");
+  if (wheel) {
+    std::cout << ", wheel (slack: " << slack.count() << " ms)";
+  }
+  std::cout << std::endl;
+  recorder.Print();
 
-  // Wait for the 2 loops to end.
-  t1.join();
-  t2.join();
+  // Without the background load, which takes whole CPUs.
+  if (load == 0) {
+    std::cout << "CPU: " << std::setprecision(1) << cpu / seconds * 100
+              << "%" << std::endl;
+  }
 
   return 0;
 }
@@ -0,0 +1,220 @@
+// Timer coalescing with slack.
+// The pattern of |timer4_multi| (many timers on one loop) and |timer5_threaded|
+// (the loop run by several threads), scaled up: each timer rearms itself with
+// its own period, like the idle timeout of a connection, for a few seconds.
+// Compares steady_timer with utility::WheelTimer, without and with slack.
+// Reports the wakeups of the loop per second, i.e., the voluntary context
+// switches (and the wakeups of the wheel), the CPU usage, and how late the
+// waits complete on average.
+// E.g.,
+//   $ timer_slack_bench --timers=100000 --slack-ms=10
+//   $ timer_slack_bench --timers=100000 --slack-ms=10 --threads=2
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+#include "timer_wheel.h"
+#include "utility.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+struct Result {
+  double seconds = 0.0;
+  double cpu_seconds = 0.0;
+  std::size_t context_switches = 0;
+  std::size_t wakeups = 0;  // Of the wheel only
+  std::size_t expired = 0;
+  double mean_late_ms = 0.0;
+};
+
+void Arm(boost::asio::steady_timer& timer, Clock::duration period,
+         Clock::duration /*slack*/) {
+  timer.expires_after(period);
+}
+
+void Arm(utility::WheelTimer& timer, Clock::duration period,
+         Clock::duration slack) {
+  timer.expires_after(period, slack);
+}
+
+std::size_t GetWakeups(boost::asio::io_context& io_context,
+                       const boost::asio::steady_timer*) {
+  return 0;
+}
+
+std::size_t GetWakeups(boost::asio::io_context& io_context,
+                       const utility::WheelTimer*) {
+  return boost::asio::use_service<utility::TimerWheelService>(io_context)
+      .wakeups();
+}
+
+template <typename Timer>
+class Periodic {
+public:
+  Periodic(boost::asio::io_context& io_context, Clock::duration period,
+           Clock::duration slack, Clock::time_point end,
+           std::atomic<std::size_t>& expired,
+           std::atomic<std::int64_t>& late_us)
+      : timer_(io_context), period_(period), slack_(slack), end_(end),
+        expired_(expired), late_us_(late_us) {
+  }
+
+  void Start() {
+    Arm(timer_, period_, slack_);
+    timer_.async_wait([this](boost::system::error_code ec) { OnExpire(ec); });
+  }
+
+private:
+  void OnExpire(boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+
+    Clock::time_point now = Clock::now();
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    late_us_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+                           now - timer_.expiry()).count(),
+                       std::memory_order_relaxed);
+
+    if (now < end_) {
+      Start();
+    }
+  }
+
+  Timer timer_;
+  Clock::duration period_;
+  Clock::duration slack_;
+  Clock::time_point end_;
+
+  std::atomic<std::size_t>& expired_;
+  std::atomic<std::int64_t>& late_us_;
+};
+
+template <typename Timer>
+Result Run(std::size_t count, std::size_t threads, Clock::duration duration,
+           Clock::duration slack) {
+  boost::asio::io_context io_context(static_cast<int>(threads));
+
+  std::atomic<std::size_t> expired{ 0 };
+  std::atomic<std::int64_t> late_us{ 0 };
+
+  // Periods of 1 ~ 5 seconds, one per timer.
+  std::mt19937 random(static_cast<std::mt19937::result_type>(count));
+  std::uniform_int_distribution<int> period_ms(1000, 5000);
+
+  Clock::time_point start = Clock::now();
+  Clock::time_point end = start + duration;
+
+  std::deque<Periodic<Timer>> timers;
+  for (std::size_t i = 0; i < count; ++i) {
+    timers.emplace_back(io_context,
+                        std::chrono::milliseconds(period_ms(random)), slack,
+                        end, expired, late_us);
+    timers.back().Start();
+  }
+
+  double cpu = utility::GetCpuSeconds();
+  std::size_t switches = utility::GetVoluntaryContextSwitches();
+  std::size_t wakeups = GetWakeups(io_context, static_cast<Timer*>(nullptr));
+
+  std::vector<std::thread> loops;
+  for (std::size_t i = 1; i < threads; ++i) {
+    loops.emplace_back([&io_context]() { io_context.run(); });
+  }
+  io_context.run();
+  for (std::thread& loop : loops) {
+    loop.join();
+  }
+
+  Result result;
+  result.seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  result.cpu_seconds = utility::GetCpuSeconds() - cpu;
+  result.context_switches =
+      utility::GetVoluntaryContextSwitches() - switches;
+  result.wakeups =
+      GetWakeups(io_context, static_cast<Timer*>(nullptr)) - wakeups;
+  result.expired = expired;
+  if (result.expired > 0) {
+    result.mean_late_ms = late_us / 1000.0 / result.expired;
+  }
+  return result;
+}
+
+void Print(const std::string& name, const Result& result) {
+  std::cout << "  " << std::left << std::setw(24) << name << std::right
+            << std::fixed << std::setprecision(0)
+            << "switches/s: " << std::setw(6)
+            << result.context_switches / result.seconds;
+  if (result.wakeups > 0) {
+    std::cout << ", wheel wakeups/s: " << std::setw(5)
+              << result.wakeups / result.seconds;
+  }
+  std::cout << std::setprecision(1)
+            << ", CPU: " << result.cpu_seconds / result.seconds * 100 << "%"
+            << std::setprecision(2)
+            << ", mean late: " << result.mean_late_ms << " ms"
+            << ", expired/s: " << std::setprecision(0)
+            << result.expired / result.seconds << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --timers=<n>        Default: 100000" << std::endl;
+  std::cout << "    --threads=<n>       Threads running the loop. Default: 1"
+            << std::endl;
+  std::cout << "    --slack-ms=<ms>     Default: 10" << std::endl;
+  std::cout << "    --seconds=<s>       Default: 10" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::size_t count = options.GetInt("timers", 100000);
+  std::size_t threads = options.GetInt("threads", 1);
+  Clock::duration slack =
+      std::chrono::milliseconds(options.GetInt("slack-ms", 10));
+  Clock::duration duration =
+      std::chrono::seconds(options.GetInt("seconds", 10));
+
+  if (count == 0 || threads == 0) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::cout << "timers: " << count << ", threads: " << threads << std::endl;
+
+  Print("steady_timer",
+        Run<boost::asio::steady_timer>(count, threads, duration,
+                                       Clock::duration::zero()));
+  Print("WheelTimer",
+        Run<utility::WheelTimer>(count, threads, duration,
+                                 Clock::duration::zero()));
+
+  std::string name = "WheelTimer, slack " +
+      std::to_string(options.GetInt("slack-ms", 10)) + "ms";
+  Print(name, Run<utility::WheelTimer>(count, threads, duration, slack));
+
+  return 0;
+}
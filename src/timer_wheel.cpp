@@ -0,0 +1,420 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace utility {
+
+namespace {
+
+const std::uint64_t kSlotMask = TimerWheelService::kSlots - 1;
+
+// Waits beyond this many ticks (~49 days) wait in the last slot of the top
+// level and get re-hashed until they're near enough.
+const std::uint64_t kMaxDelta =
+    (std::uint64_t(1) << (TimerWheelService::kLevels *
+                          TimerWheelService::kSlotBits)) - 1;
+
+int FirstBit(std::uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int bit = 0;
+  while ((word & 1) == 0) {
+    word >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+int LastBit(std::uint64_t word) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(word);
+#else
+  int bit = -1;
+  while (word != 0) {
+    word >>= 1;
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+// The tick in [tick, limit] that is a multiple of the largest power of two,
+// like the timer slack of Linux.
+std::uint64_t ApplySlack(std::uint64_t tick, std::uint64_t limit) {
+  if (limit <= tick) {
+    return tick;
+  }
+  // The highest bit that differs is set in |limit|; clear all below it.
+  std::uint64_t mask = (std::uint64_t(1) << LastBit(tick ^ limit)) - 1;
+  return limit & ~mask;
+}
+
+}  // namespace
+
+boost::asio::io_context::id TimerWheelService::id;
+
+const TimerWheelService::clock_type::duration TimerWheelService::kTick =
+    std::chrono::milliseconds(1);
+
+const int TimerWheelService::kLevels;
+const int TimerWheelService::kSlotBits;
+const std::size_t TimerWheelService::kSlots;
+
+TimerWheelService::TimerWheelService(boost::asio::io_context& io_context)
+    : boost::asio::io_context::service(io_context),
+      origin_(clock_type::now()), current_(0), pending_(0), wakeups_(0),
+      driver_(io_context), armed_(false), armed_tick_(0), generation_(0) {
+  std::fill(std::begin(slots_), std::end(slots_), nullptr);
+  std::fill(std::begin(occupied_), std::end(occupied_), 0);
+}
+
+TimerWheelService::~TimerWheelService() {
+}
+
+void TimerWheelService::Construct(Implementation& impl) {
+  impl.expiry = clock_type::time_point();
+  impl.slack = clock_type::duration::zero();
+  impl.waits = nullptr;
+}
+
+void TimerWheelService::Destroy(Implementation& impl) {
+  Cancel(impl);
+}
+
+std::size_t TimerWheelService::Cancel(Implementation& impl) {
+  Op* cancelled = nullptr;
+  std::size_t count = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (Op* op = impl.waits; op != nullptr; op = op->next_wait_) {
+      Unlink(op);
+      op->next_ = cancelled;
+      cancelled = op;
+      ++count;
+    }
+    impl.waits = nullptr;
+    pending_ -= count;
+
+    // Don't keep the io_context running for nothing.
+    if (pending_ == 0 && armed_) {
+      armed_ = false;
+      ++generation_;
+      driver_.cancel();
+    }
+  }
+
+  while (cancelled != nullptr) {
+    Op* op = cancelled;
+    cancelled = op->next_;
+    op->Complete(boost::asio::error::operation_aborted, true);
+  }
+
+  return count;
+}
+
+void TimerWheelService::Schedule(Implementation& impl, Op* op) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  op->impl_ = &impl;
+  op->next_wait_ = impl.waits;
+  impl.waits = op;
+
+  op->tick_ = TickOf(impl.expiry, true);
+  if (impl.slack > clock_type::duration::zero()) {
+    op->tick_ = ApplySlack(op->tick_, TickOf(impl.expiry + impl.slack, false));
+  }
+  Link(op);
+  ++pending_;
+
+  if (!armed_ || op->tick_ < armed_tick_) {
+    Arm(NextTick());
+  }
+}
+
+std::size_t TimerWheelService::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+std::size_t TimerWheelService::wakeups() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return wakeups_;
+}
+
+void TimerWheelService::shutdown() {
+  Op* abandoned = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (std::size_t slot = 0; slot < kLevels * kSlots; ++slot) {
+      Op* op = TakeSlot(slot);
+      while (op != nullptr) {
+        Op* next = op->next_;
+        op->impl_->waits = nullptr;
+        op->next_ = abandoned;
+        abandoned = op;
+        op = next;
+      }
+    }
+    pending_ = 0;
+    armed_ = false;
+  }
+
+  // Free the pending waits without invoking the handlers, and without the
+  // lock: a handler may own the last reference to its timer, whose
+  // destruction cancels (i.e., locks) again.
+  while (abandoned != nullptr) {
+    Op* op = abandoned;
+    abandoned = op->next_;
+    op->Destroy();
+  }
+}
+
+std::uint64_t TimerWheelService::TickOf(clock_type::time_point time,
+                                        bool round_up) const {
+  if (time <= origin_) {
+    return 0;
+  }
+  clock_type::duration since = time - origin_;
+  std::uint64_t tick = static_cast<std::uint64_t>(since / kTick);
+  if (round_up && since % kTick != clock_type::duration::zero()) {
+    ++tick;
+  }
+  return tick;
+}
+
+TimerWheelService::clock_type::time_point TimerWheelService::TimeOf(
+    std::uint64_t tick) const {
+  return origin_ + kTick * static_cast<clock_type::rep>(tick);
+}
+
+void TimerWheelService::Link(Op* op) {
+  // Expired waits go to the slot expiring next.
+  std::uint64_t tick = (std::max)(op->tick_, current_);
+  std::uint64_t delta = (std::min)(tick - current_, kMaxDelta);
+  tick = current_ + delta;
+
+  int level = 0;
+  while (level < kLevels - 1 &&
+         delta >= (std::uint64_t(1) << ((level + 1) * kSlotBits))) {
+    ++level;
+  }
+
+  std::size_t slot = level * kSlots +
+                     ((tick >> (level * kSlotBits)) & kSlotMask);
+
+  Op*& head = slots_[slot];
+  op->prev_ = nullptr;
+  op->next_ = head;
+  if (head != nullptr) {
+    head->prev_ = op;
+  }
+  head = op;
+  op->slot_ = &head;
+
+  occupied_[slot / 64] |= std::uint64_t(1) << (slot % 64);
+}
+
+void TimerWheelService::Unlink(Op* op) {
+  if (op->prev_ != nullptr) {
+    op->prev_->next_ = op->next_;
+  } else {
+    *op->slot_ = op->next_;
+  }
+  if (op->next_ != nullptr) {
+    op->next_->prev_ = op->prev_;
+  }
+
+  if (*op->slot_ == nullptr) {
+    std::size_t slot = static_cast<std::size_t>(op->slot_ - slots_);
+    occupied_[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+  }
+
+  op->prev_ = op->next_ = nullptr;
+  op->slot_ = nullptr;
+}
+
+TimerWheelService::Op* TimerWheelService::TakeSlot(std::size_t slot) {
+  Op* head = slots_[slot];
+  slots_[slot] = nullptr;
+  occupied_[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+
+  for (Op* op = head; op != nullptr; op = op->next_) {
+    op->prev_ = nullptr;
+    op->slot_ = nullptr;
+  }
+  return head;
+}
+
+void TimerWheelService::Cascade() {
+  for (int level = 1; level < kLevels; ++level) {
+    std::size_t index = (current_ >> (level * kSlotBits)) & kSlotMask;
+
+    Op* op = TakeSlot(level * kSlots + index);
+    while (op != nullptr) {
+      Op* next = op->next_;
+      Link(op);
+      op = next;
+    }
+
+    // Only cascade the level above if this one has wrapped around too.
+    if (index != 0) {
+      break;
+    }
+  }
+}
+
+void TimerWheelService::Advance(std::uint64_t now, Op*& ready_head,
+                                Op*& ready_tail) {
+  while (current_ <= now) {
+    std::size_t index = current_ & kSlotMask;
+    if (index == 0) {
+      Cascade();
+    }
+
+    Op* op = TakeSlot(index);
+    while (op != nullptr) {
+      Op* next = op->next_;
+
+      // Remove it from the waits of its timer.
+      Op** wait = &op->impl_->waits;
+      while (*wait != op) {
+        wait = &(*wait)->next_wait_;
+      }
+      *wait = op->next_wait_;
+      --pending_;
+
+      op->next_ = nullptr;
+      if (ready_tail != nullptr) {
+        ready_tail->next_ = op;
+      } else {
+        ready_head = op;
+      }
+      ready_tail = op;
+
+      op = next;
+    }
+
+    // Skip the empty slots, up to the next cascade at most.
+    std::size_t next = NextOccupied(0, index + 1);
+    current_ = (std::min)(current_ + (next - index), now + 1);
+  }
+}
+
+std::size_t TimerWheelService::NextOccupied(int level,
+                                            std::size_t index) const {
+  const std::uint64_t* words = occupied_ + level * kSlots / 64;
+
+  while (index < kSlots) {
+    std::uint64_t word = words[index / 64] >> (index % 64);
+    if (word != 0) {
+      return index + FirstBit(word);
+    }
+    index = (index / 64 + 1) * 64;
+  }
+  return kSlots;
+}
+
+std::uint64_t TimerWheelService::NextTick() const {
+  std::size_t index = current_ & kSlotMask;
+
+  // Level 0 has wrapped around but the upper levels aren't cascaded yet.
+  if (index == 0) {
+    return current_;
+  }
+
+  // The next non-empty slot of level 0, or the next cascade.
+  return current_ - index + NextOccupied(0, index);
+}
+
+void TimerWheelService::Arm(std::uint64_t tick) {
+  armed_ = true;
+  armed_tick_ = tick;
+  ++generation_;
+
+  driver_.expires_at(TimeOf(tick));
+  driver_.async_wait(std::bind(&TimerWheelService::OnTick, this, generation_,
+                               std::placeholders::_1));
+}
+
+void TimerWheelService::OnTick(std::uint64_t generation,
+                               boost::system::error_code ec) {
+  Op* ready_head = nullptr;
+  Op* ready_tail = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Rearmed or cancelled since.
+    if (ec || generation != generation_) {
+      return;
+    }
+
+    armed_ = false;
+    ++wakeups_;
+
+    Advance(TickOf(clock_type::now(), false), ready_head, ready_tail);
+
+    if (pending_ > 0) {
+      Arm(NextTick());
+    }
+  }
+
+  // Complete outside the lock; the handlers may wait again.
+  while (ready_head != nullptr) {
+    Op* op = ready_head;
+    ready_head = op->next_;
+    op->Complete(boost::system::error_code(), false);
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+WheelTimer::WheelTimer(boost::asio::io_context& io_context)
+    : service_(boost::asio::use_service<TimerWheelService>(io_context)),
+      executor_(io_context.get_executor()) {
+  service_.Construct(impl_);
+}
+
+WheelTimer::WheelTimer(boost::asio::io_context& io_context,
+                       const duration& expiry_time)
+    : WheelTimer(io_context) {
+  expires_after(expiry_time);
+}
+
+WheelTimer::~WheelTimer() {
+  service_.Destroy(impl_);
+}
+
+std::size_t WheelTimer::expires_at(const time_point& expiry_time) {
+  return expires_at(expiry_time, duration::zero());
+}
+
+std::size_t WheelTimer::expires_after(const duration& expiry_time) {
+  return expires_at(clock_type::now() + expiry_time, duration::zero());
+}
+
+std::size_t WheelTimer::expires_at(const time_point& expiry_time,
+                                   const duration& slack) {
+  std::size_t count = service_.Cancel(impl_);
+  impl_.expiry = expiry_time;
+  impl_.slack = slack;
+  return count;
+}
+
+std::size_t WheelTimer::expires_after(const duration& expiry_time,
+                                      const duration& slack) {
+  return expires_at(clock_type::now() + expiry_time, slack);
+}
+
+std::size_t WheelTimer::cancel() {
+  return service_.Cancel(impl_);
+}
+
+}  // namespace utility
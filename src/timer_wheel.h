@@ -0,0 +1,311 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+// Hierarchical timing wheel timers for boost::asio::io_context.
+//
+// Asio keeps the waits of |steady_timer| in a binary heap per io_context,
+// i.e., O(log n) to arm or cancel a wait. A timing wheel hashes each wait
+// into a slot by its deadline instead, O(1) to arm or cancel, at the cost of
+// a resolution of one tick (1 ms): a wait never completes before its deadline
+// but may complete up to one tick after it.
+//
+// Like the classic Linux timer wheel, there are 4 levels of 256 slots. Level
+// 0 covers the next 256 ticks, one tick per slot; level 1 the next 65536
+// ticks, 256 ticks per slot; and so on. Each time level 0 wraps around, the
+// next slot of level 1 is cascaded (re-hashed) into level 0, etc.
+//
+// The wheel is a service of the io_context (see |context_and_services|),
+// driven by one internal steady_timer armed for the next non-empty slot.
+// |WheelTimer| is the I/O object, with the interface of |steady_timer|:
+//   utility::WheelTimer timer{ io_context, std::chrono::seconds(3) };
+//   timer.async_wait(&Print);
+//
+// A wait may also carry a slack, i.e., how late it may complete (see
+// WheelTimer::expires_after()). Its deadline is then rounded up, within the
+// slack, to a multiple of the largest power of two ticks possible, so that
+// the waits of many timers share slots and one wakeup expires them all.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "boost/asio/associated_executor.hpp"
+#include "boost/asio/async_result.hpp"
+#include "boost/asio/dispatch.hpp"
+#include "boost/asio/error.hpp"
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+namespace utility {
+
+class TimerWheelService : public boost::asio::io_context::service {
+public:
+  typedef std::chrono::steady_clock clock_type;
+
+  static boost::asio::io_context::id id;
+
+  // The resolution of the wheel.
+  static const clock_type::duration kTick;
+
+  static const int kLevels = 4;
+  static const int kSlotBits = 8;
+  static const std::size_t kSlots = 1 << kSlotBits;
+
+  struct Implementation;
+
+  // A pending wait, linked into a slot of the wheel.
+  class Op {
+  public:
+    // Invoke the handler through its associated executor: |post| it after a
+    // cancellation, |dispatch| it on expiry (already inside the io_context).
+    void Complete(const boost::system::error_code& ec, bool post) {
+      func_(this, &ec, post);
+    }
+
+    // Free it without invoking the handler.
+    void Destroy() {
+      func_(this, nullptr, false);
+    }
+
+  protected:
+    typedef void (*Func)(Op*, const boost::system::error_code*, bool);
+
+    explicit Op(Func func)
+        : func_(func), prev_(nullptr), next_(nullptr), next_wait_(nullptr),
+          slot_(nullptr), impl_(nullptr), tick_(0) {
+    }
+
+    ~Op() = default;
+
+  private:
+    friend class TimerWheelService;
+
+    Func func_;
+
+    Op* prev_;
+    Op* next_;       // In the slot, or in a list of completed ops
+    Op* next_wait_;  // The next wait of the same timer
+
+    Op** slot_;  // The head of the slot, nullptr if not in the wheel
+    Implementation* impl_;
+    std::uint64_t tick_;
+  };
+
+  // Per timer state.
+  struct Implementation {
+    clock_type::time_point expiry;
+    clock_type::duration slack = clock_type::duration::zero();
+    Op* waits = nullptr;  // The pending waits
+  };
+
+  explicit TimerWheelService(boost::asio::io_context& io_context);
+
+  ~TimerWheelService();
+
+  void Construct(Implementation& impl);
+
+  // Cancel the pending waits.
+  void Destroy(Implementation& impl);
+
+  // Complete the pending waits with operation_aborted.
+  // Return the number of waits cancelled.
+  std::size_t Cancel(Implementation& impl);
+
+  // Add |op| as a wait for |impl.expiry|, within |impl.slack|.
+  void Schedule(Implementation& impl, Op* op);
+
+  // The number of pending waits.
+  std::size_t pending() const;
+
+  // How many times the internal timer has woken up to expire waits.
+  std::size_t wakeups() const;
+
+private:
+  void shutdown() override;
+
+  // The first tick not before |time| (round_up), or the last tick not after
+  // it.
+  std::uint64_t TickOf(clock_type::time_point time, bool round_up) const;
+
+  clock_type::time_point TimeOf(std::uint64_t tick) const;
+
+  // Link |op| into the slot of its tick, relative to |current_|.
+  void Link(Op* op);
+
+  void Unlink(Op* op);
+
+  // Remove all the ops of a slot, returned as a list linked by |next_|.
+  Op* TakeSlot(std::size_t slot);
+
+  // Re-hash the next slots of the upper levels as level 0 wraps around.
+  void Cascade();
+
+  // Expire all the ticks up to |now|; append the expired ops to
+  // |ready_head|/|ready_tail|.
+  void Advance(std::uint64_t now, Op*& ready_head, Op*& ready_tail);
+
+  // The first slot at or after |index| of |level| that isn't empty, or
+  // |kSlots| if none.
+  std::size_t NextOccupied(int level, std::size_t index) const;
+
+  // The tick at which to wake up next; only if there are pending waits.
+  std::uint64_t NextTick() const;
+
+  void Arm(std::uint64_t tick);
+
+  void OnTick(std::uint64_t generation, boost::system::error_code ec);
+
+  mutable std::mutex mutex_;
+
+  // The heads of the slots of all levels; level L at [L * kSlots].
+  Op* slots_[kLevels * kSlots];
+
+  // A bit per slot, set if the slot isn't empty.
+  std::uint64_t occupied_[kLevels * kSlots / 64];
+
+  clock_type::time_point origin_;  // Time of tick 0
+  std::uint64_t current_;          // The next tick to expire
+
+  std::size_t pending_;
+  std::size_t wakeups_;
+
+  // The internal timer driving the wheel.
+  boost::asio::steady_timer driver_;
+  bool armed_;
+  std::uint64_t armed_tick_;
+  std::uint64_t generation_;  // Identifies the latest wait of |driver_|
+};
+
+// -----------------------------------------------------------------------------
+
+namespace detail {
+
+template <typename Handler>
+class WheelWaitOp : public TimerWheelService::Op {
+public:
+  WheelWaitOp(Handler&& handler,
+              const boost::asio::io_context::executor_type& io_executor)
+      : Op(&WheelWaitOp::DoComplete), handler_(std::move(handler)),
+        io_executor_(io_executor) {
+  }
+
+private:
+  // Binds the error code so that the handler could be posted.
+  struct Binder {
+    void operator()() { handler(ec); }
+
+    Handler handler;
+    boost::system::error_code ec;
+  };
+
+  static void DoComplete(Op* base, const boost::system::error_code* ec,
+                         bool post) {
+    WheelWaitOp* op = static_cast<WheelWaitOp*>(base);
+
+    // Free the op before the upcall so that the handler may wait again
+    // without holding two.
+    Binder binder{ std::move(op->handler_),
+                   ec != nullptr ? *ec : boost::system::error_code() };
+    auto executor =
+        boost::asio::get_associated_executor(binder.handler, op->io_executor_);
+    delete op;
+
+    if (ec == nullptr) {
+      return;
+    }
+
+    if (post) {
+      boost::asio::post(executor, std::move(binder));
+    } else {
+      boost::asio::dispatch(executor, std::move(binder));
+    }
+  }
+
+  Handler handler_;
+  boost::asio::io_context::executor_type io_executor_;
+};
+
+}  // namespace detail
+
+// -----------------------------------------------------------------------------
+
+// A timer on the timing wheel, used like |steady_timer|.
+class WheelTimer {
+public:
+  typedef TimerWheelService::clock_type clock_type;
+  typedef clock_type::duration duration;
+  typedef clock_type::time_point time_point;
+  typedef boost::asio::io_context::executor_type executor_type;
+
+  explicit WheelTimer(boost::asio::io_context& io_context);
+
+  WheelTimer(boost::asio::io_context& io_context,
+             const duration& expiry_time);
+
+  ~WheelTimer();
+
+  WheelTimer(const WheelTimer&) = delete;
+  WheelTimer& operator=(const WheelTimer&) = delete;
+
+  executor_type get_executor() { return executor_; }
+
+  time_point expiry() const { return impl_.expiry; }
+
+  // Set the expiry time, cancelling any pending waits.
+  // Return the number of waits cancelled.
+  std::size_t expires_at(const time_point& expiry_time);
+
+  std::size_t expires_after(const duration& expiry_time);
+
+  // The same, but the waits may complete as late as |expiry_time + slack| to
+  // be coalesced with the waits of other timers.
+  std::size_t expires_at(const time_point& expiry_time,
+                         const duration& slack);
+
+  std::size_t expires_after(const duration& expiry_time,
+                            const duration& slack);
+
+  duration slack() const { return impl_.slack; }
+
+  std::size_t cancel();
+
+  // WaitHandler: void (boost::system::error_code)
+  template <typename WaitHandler>
+  BOOST_ASIO_INITFN_RESULT_TYPE(WaitHandler, void(boost::system::error_code))
+  async_wait(WaitHandler&& handler) {
+    return boost::asio::async_initiate<WaitHandler,
+                                       void(boost::system::error_code)>(
+        InitiateAsyncWait(this), handler);
+  }
+
+private:
+  class InitiateAsyncWait {
+  public:
+    explicit InitiateAsyncWait(WheelTimer* self) : self_(self) {
+    }
+
+    template <typename Handler>
+    void operator()(Handler&& handler) const {
+      typedef typename std::decay<Handler>::type DecayedHandler;
+      DecayedHandler decayed(std::forward<Handler>(handler));
+      auto* op = new detail::WheelWaitOp<DecayedHandler>(std::move(decayed),
+                                                         self_->executor_);
+      self_->service_.Schedule(self_->impl_, op);
+    }
+
+  private:
+    WheelTimer* self_;
+  };
+
+  TimerWheelService& service_;
+  executor_type executor_;
+  TimerWheelService::Implementation impl_;
+};
+
+}  // namespace utility
+
+#endif  // TIMER_WHEEL_H_
@@ -0,0 +1,159 @@
+// Benchmark of utility::WheelTimer (timing wheel) against steady_timer (heap).
+// For each count, the timers are
+//   - armed with random deadlines within the span (e.g., 1 ~ 2 seconds);
+//   - rearmed once each with another random deadline, i.e., the wait is
+//     cancelled and started again, like an idle timeout on every read;
+//   - left to expire while the io_context runs.
+// Reports the time per arm and rearm, the CPU time per expiry, and how late
+// the waits complete.
+// E.g.,
+//   $ timer_wheel_bench --counts=10000,1000000,10000000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/steady_timer.hpp"
+
+#include "timer_wheel.h"
+#include "utility.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+struct Result {
+  double arm_ns = 0.0;     // Per arm
+  double rearm_ns = 0.0;   // Per rearm
+  double expire_ns = 0.0;  // CPU per expiry (and per cancelled wait)
+  double max_late_ms = 0.0;
+  std::size_t expired = 0;
+  std::size_t aborted = 0;
+  std::size_t early = 0;  // Should always be 0
+};
+
+template <typename Timer>
+Result Run(std::size_t count, Clock::duration span) {
+  boost::asio::io_context io_context(1);
+  std::deque<Timer> timers;
+
+  std::mt19937 random(count);
+  std::uniform_int_distribution<Clock::rep> deadline(span.count(),
+                                                     2 * span.count());
+
+  Result result;
+  Clock::duration max_late = Clock::duration::zero();
+
+  auto wait = [&](Timer& timer) {
+    timer.async_wait([&](boost::system::error_code ec) {
+      if (ec) {
+        ++result.aborted;
+        return;
+      }
+      ++result.expired;
+      Clock::duration late = Clock::now() - timer.expiry();
+      if (late < Clock::duration::zero()) {
+        ++result.early;
+      }
+      max_late = (std::max)(max_late, late);
+    });
+  };
+
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    timers.emplace_back(io_context);
+    timers.back().expires_after(Clock::duration(deadline(random)));
+    wait(timers.back());
+  }
+  std::chrono::duration<double, std::nano> arm = Clock::now() - start;
+
+  start = Clock::now();
+  for (Timer& timer : timers) {
+    timer.expires_after(Clock::duration(deadline(random)));
+    wait(timer);
+  }
+  std::chrono::duration<double, std::nano> rearm = Clock::now() - start;
+
+  double cpu = utility::GetCpuSeconds();
+  io_context.run();
+  cpu = utility::GetCpuSeconds() - cpu;
+
+  result.arm_ns = arm.count() / count;
+  result.rearm_ns = rearm.count() / count;
+  result.expire_ns = cpu * 1e9 / (result.expired + result.aborted);
+  result.max_late_ms =
+      std::chrono::duration<double, std::milli>(max_late).count();
+  return result;
+}
+
+void Print(const std::string& name, const Result& result) {
+  std::cout << "  " << std::left << std::setw(14) << name << std::right
+            << std::fixed << std::setprecision(0)
+            << "arm: " << std::setw(5) << result.arm_ns << " ns"
+            << ", rearm: " << std::setw(5) << result.rearm_ns << " ns"
+            << ", expire: " << std::setw(5) << result.expire_ns << " ns"
+            << std::setprecision(2)
+            << ", max late: " << result.max_late_ms << " ms"
+            << ", expired: " << result.expired
+            << ", early: " << result.early << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::size_t> ParseCounts(const std::string& str) {
+  std::vector<std::size_t> counts;
+  std::istringstream stream(str);
+  std::string count;
+  while (std::getline(stream, count, ',')) {
+    std::size_t n = std::strtoul(count.c_str(), nullptr, 10);
+    if (n > 0) {
+      counts.push_back(n);
+    }
+  }
+  return counts;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --counts=<n,...>  Default: 10000,1000000,10000000"
+            << std::endl;
+  std::cout << "    --span-ms=<ms>    Deadlines in span ~ 2 * span."
+            << " Default: 1000" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options options(argc, argv);
+
+  if (options.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::vector<std::size_t> counts =
+      ParseCounts(options.Get("counts", "10000,1000000,10000000"));
+  if (counts.empty()) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  Clock::duration span = std::chrono::milliseconds(
+      options.GetInt("span-ms", 1000));
+
+  for (std::size_t count : counts) {
+    std::cout << "timers: " << count << std::endl;
+    Print("steady_timer", Run<boost::asio::steady_timer>(count, span));
+    Print("WheelTimer", Run<utility::WheelTimer>(count, span));
+  }
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Tests of utility::WheelTimer:
+//   - the waits complete in the order of their deadlines and never early,
+//     also across the cascades from level 1 into level 0;
+//   - cancel() completes a pending wait with operation_aborted;
+//   - expires_after() on a pending wait aborts it, the new one completes;
+//   - a wait with slack never completes before its deadline;
+//   - teardown: destroy an io_context with a pending wait whose handler owns
+//     the last reference to its timer (the usual shared_from_this() session).
+//     The service frees the handler, which destroys the timer, which cancels
+//     its waits through the service again; this must not deadlock (run by
+//     ctest with a timeout).
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+
+#include "timer_wheel.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define EXPECT(condition)                                             \
+  if (!(condition)) {                                                 \
+    std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition    \
+              << std::endl;                                           \
+    return false;                                                     \
+  }
+
+bool TestOrderAcrossCascade() {
+  // Level 0 covers 256 ticks (ms); the later deadlines start in level 1 and
+  // are cascaded at 256 and 512 ms.
+  const int kDeadlinesMs[] = { 600, 5, 513, 256, 255, 300, 512, 257, 100, 511 };
+
+  boost::asio::io_context io_context;
+  Clock::time_point base = Clock::now();
+
+  struct Completion {
+    int deadline_ms;
+    bool early;
+  };
+  std::vector<Completion> completions;
+
+  std::deque<utility::WheelTimer> timers;
+  for (int deadline_ms : kDeadlinesMs) {
+    timers.emplace_back(io_context);
+    utility::WheelTimer& timer = timers.back();
+    timer.expires_at(base + std::chrono::milliseconds(deadline_ms));
+    timer.async_wait([&completions, &timer, deadline_ms](
+                         boost::system::error_code ec) {
+      if (!ec) {
+        completions.push_back({ deadline_ms, Clock::now() < timer.expiry() });
+      }
+    });
+  }
+
+  io_context.run();
+
+  EXPECT(completions.size() == timers.size());
+  for (std::size_t i = 0; i < completions.size(); ++i) {
+    EXPECT(!completions[i].early);
+    if (i > 0) {
+      EXPECT(completions[i - 1].deadline_ms < completions[i].deadline_ms);
+    }
+  }
+  return true;
+}
+
+bool TestCancel() {
+  boost::asio::io_context io_context;
+  utility::WheelTimer timer(io_context, std::chrono::seconds(10));
+
+  boost::system::error_code result;
+  bool called = false;
+  timer.async_wait([&](boost::system::error_code ec) {
+    result = ec;
+    called = true;
+  });
+
+  EXPECT(timer.cancel() == 1);
+
+  // Not the 10 seconds.
+  Clock::time_point start = Clock::now();
+  io_context.run();
+
+  EXPECT(called);
+  EXPECT(result == boost::asio::error::operation_aborted);
+  EXPECT(Clock::now() - start < std::chrono::seconds(1));
+  return true;
+}
+
+bool TestExpiresAfterPending() {
+  boost::asio::io_context io_context;
+  utility::WheelTimer timer(io_context, std::chrono::seconds(10));
+
+  std::vector<boost::system::error_code> results;
+  timer.async_wait([&](boost::system::error_code ec) {
+    results.push_back(ec);
+  });
+
+  EXPECT(timer.expires_after(std::chrono::milliseconds(20)) == 1);
+
+  bool early = false;
+  timer.async_wait([&](boost::system::error_code ec) {
+    early = Clock::now() < timer.expiry();
+    results.push_back(ec);
+  });
+
+  io_context.run();
+
+  EXPECT(results.size() == 2);
+  EXPECT(results[0] == boost::asio::error::operation_aborted);
+  EXPECT(!results[1]);
+  EXPECT(!early);
+  return true;
+}
+
+bool TestSlackNotEarly() {
+  const int kTimers = 50;
+
+  boost::asio::io_context io_context;
+  Clock::time_point base = Clock::now();
+
+  int completed = 0;
+  int early = 0;
+
+  std::deque<utility::WheelTimer> timers;
+  for (int i = 0; i < kTimers; ++i) {
+    timers.emplace_back(io_context);
+    utility::WheelTimer& timer = timers.back();
+    // Deadlines 1 ~ 197 ms, 4 ms apart, each with 50 ms of slack.
+    timer.expires_at(base + std::chrono::milliseconds(1 + i * 4),
+                     std::chrono::milliseconds(50));
+    timer.async_wait([&completed, &early, &timer](
+                         boost::system::error_code ec) {
+      if (!ec) {
+        ++completed;
+        if (Clock::now() < timer.expiry()) {
+          ++early;
+        }
+      }
+    });
+  }
+
+  io_context.run();
+
+  EXPECT(completed == kTimers);
+  EXPECT(early == 0);
+  return true;
+}
+
+struct Session {
+  explicit Session(boost::asio::io_context& io_context) : timer(io_context) {
+  }
+
+  utility::WheelTimer timer;
+};
+
+bool TestTeardownWithPendingWait() {
+  std::weak_ptr<Session> weak;
+  bool invoked = false;
+
+  {
+    boost::asio::io_context io_context;
+
+    std::shared_ptr<Session> session = std::make_shared<Session>(io_context);
+    weak = session;
+
+    session->timer.expires_after(std::chrono::hours(1));
+    session->timer.async_wait(
+        [session, &invoked](boost::system::error_code) { invoked = true; });
+
+    // The handler now owns the session.
+    session.reset();
+  }
+
+  EXPECT(weak.expired());
+  EXPECT(!invoked);
+  return true;
+}
+
+int main() {
+  bool ok = true;
+  ok = TestOrderAcrossCascade() && ok;
+  ok = TestCancel() && ok;
+  ok = TestExpiresAfterPending() && ok;
+  ok = TestSlackNotEarly() && ok;
+  ok = TestTeardownWithPendingWait() && ok;
+
+  std::cout << (ok ? "OK" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,373 @@
+#include "tls_utility.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "openssl/evp.h"
+#include "openssl/objects.h"
+#include "openssl/rand.h"
+#include "openssl/ssl.h"
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include "openssl/core_names.h"
+#else
+#include "openssl/hmac.h"
+#endif
+
+namespace ssl = boost::asio::ssl;
+
+namespace utility {
+
+namespace {
+
+// Index of the TicketKeyRing in the ex data of SSL_CTX.
+int TicketKeyRingIndex() {
+  static const int index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+TicketKeyRing* GetTicketKeyRing(SSL* ssl) {
+  SSL_CTX* ssl_ctx = SSL_get_SSL_CTX(ssl);
+  return static_cast<TicketKeyRing*>(
+      SSL_CTX_get_ex_data(ssl_ctx, TicketKeyRingIndex()));
+}
+
+// Return value (see SSL_CTX_set_tlsext_ticket_key_cb):
+//   encryption: 1 - OK, -1 - error
+//   decryption: 0 - unknown key (full handshake), 1 - OK, 2 - OK but renew
+//               the ticket, -1 - error
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int TicketKeyCallback(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipher_ctx, EVP_MAC_CTX* mac_ctx,
+                      int enc) {
+#else
+int TicketKeyCallback(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipher_ctx, HMAC_CTX* mac_ctx,
+                      int enc) {
+#endif
+  TicketKeyRing* key_ring = GetTicketKeyRing(ssl);
+  if (key_ring == nullptr) {
+    return -1;
+  }
+
+  TicketKeyRing::Key key;
+  bool is_current = true;
+
+  if (enc == 1) {
+    if (!key_ring->CurrentKey(&key)) {
+      return -1;
+    }
+    std::memcpy(key_name, key.name.data(), key.name.size());
+    if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+      return -1;
+    }
+  } else {
+    if (!key_ring->FindKey(key_name, &key, &is_current)) {
+      key_ring->CountMiss();
+      return 0;
+    }
+  }
+
+  if (enc == 1) {
+    if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr,
+                           key.aes_key.data(), iv) != 1) {
+      return -1;
+    }
+  } else {
+    if (EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr,
+                           key.aes_key.data(), iv) != 1) {
+      return -1;
+    }
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                     const_cast<char*>("SHA256"), 0),
+    OSSL_PARAM_construct_end(),
+  };
+  if (EVP_MAC_init(mac_ctx, key.hmac_key.data(), key.hmac_key.size(),
+                   params) != 1) {
+    return -1;
+  }
+#else
+  if (HMAC_Init_ex(mac_ctx, key.hmac_key.data(),
+                   static_cast<int>(key.hmac_key.size()), EVP_sha256(),
+                   nullptr) != 1) {
+    return -1;
+  }
+#endif
+
+  if (enc == 1) {
+    return 1;
+  }
+
+  key_ring->CountHit(is_current);
+  return is_current ? 1 : 2;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+void ApplyTlsProfile(ssl::context& ssl_context, const std::string& profile,
+                     const std::string& dh_file) {
+  SSL_CTX* ssl_ctx = ssl_context.native_handle();
+
+  // X25519 first, it's the fastest.
+  const char* kGroups = "X25519:P-256";
+
+  if (profile == "compat") {
+    ssl_context.use_tmp_dh_file(dh_file);
+
+  } else if (profile == "ffdhe") {
+    SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ssl_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_cipher_list(ssl_ctx, "DHE+AESGCM:DHE+CHACHA20");
+    ssl_context.use_tmp_dh_file(dh_file);
+
+  } else if (profile == "ecdhe") {
+    SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_2_VERSION);
+    // The TLS 1.3 key exchange is always (EC)DHE; only the groups matter.
+    SSL_CTX_set_cipher_list(ssl_ctx, "ECDHE+AESGCM:ECDHE+CHACHA20");
+    SSL_CTX_set1_groups_list(ssl_ctx, kGroups);
+    SSL_CTX_set_options(ssl_ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+  } else if (profile == "tls13") {
+    SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_3_VERSION);
+    SSL_CTX_set1_groups_list(ssl_ctx, kGroups);
+
+  } else {
+    throw std::invalid_argument("Unknown TLS profile: " + profile);
+  }
+}
+
+std::vector<std::string> GetTlsProfiles() {
+  return { "compat", "ffdhe", "ecdhe", "tls13" };
+}
+
+std::string DescribeTlsConnection(SSL* ssl) {
+  if (!SSL_is_init_finished(ssl)) {
+    return "No TLS connection";
+  }
+
+  std::string description = SSL_get_version(ssl);
+  description += " ";
+  description += SSL_get_cipher_name(ssl);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  int group = SSL_get_negotiated_group(ssl);
+  if (group != 0 && group != NID_undef) {
+    const char* name = OBJ_nid2sn(group & ~TLSEXT_nid_unknown);
+    description += " ";
+    description += name != nullptr ? name : "?";
+  }
+#endif
+
+  return description;
+}
+
+// -----------------------------------------------------------------------------
+
+std::string EncodeAlpnProtocols(const std::vector<std::string>& protocols) {
+  std::string encoded;
+  for (const std::string& protocol : protocols) {
+    if (protocol.empty() || protocol.size() > 255) {
+      throw std::invalid_argument("Invalid ALPN protocol: " + protocol);
+    }
+    encoded += static_cast<char>(protocol.size());
+    encoded += protocol;
+  }
+  return encoded;
+}
+
+bool SetAlpnProtocols(SSL* ssl, const std::string& encoded) {
+  // NOTE: Unlike most of OpenSSL, 0 means success.
+  return SSL_set_alpn_protos(
+             ssl, reinterpret_cast<const unsigned char*>(encoded.data()),
+             static_cast<unsigned int>(encoded.size())) == 0;
+}
+
+namespace {
+
+int SelectAlpnProtocol(SSL* ssl, const unsigned char** out,
+                       unsigned char* outlen, const unsigned char* in,
+                       unsigned int inlen, void* arg) {
+  const std::string* encoded = static_cast<const std::string*>(arg);
+
+  // SSL_select_next_proto() prefers the order of its first list.
+  unsigned char* selected = nullptr;
+  if (SSL_select_next_proto(
+          &selected, outlen, in, inlen,
+          reinterpret_cast<const unsigned char*>(encoded->data()),
+          static_cast<unsigned int>(encoded->size())) !=
+      OPENSSL_NPN_NEGOTIATED) {
+    return SSL_TLSEXT_ERR_NOACK;
+  }
+
+  *out = selected;
+  return SSL_TLSEXT_ERR_OK;
+}
+
+}  // namespace
+
+void SetAlpnSelection(ssl::context& ssl_context, const std::string* encoded) {
+  SSL_CTX_set_alpn_select_cb(ssl_context.native_handle(), &SelectAlpnProtocol,
+                             const_cast<std::string*>(encoded));
+}
+
+std::string GetAlpnProtocol(SSL* ssl) {
+  const unsigned char* data = nullptr;
+  unsigned int size = 0;
+  SSL_get0_alpn_selected(ssl, &data, &size);
+  return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+// -----------------------------------------------------------------------------
+
+DirectSocketIo::DirectSocketIo(SSL* ssl, int fd)
+    : ssl_(ssl), stream_bio_(SSL_get_rbio(ssl)) {
+  // SSL_set_fd() releases the references of the SSL object to the stream's
+  // BIO (one as the read BIO, one as the write BIO); keep it alive.
+  BIO_up_ref(stream_bio_);
+
+  if (SSL_set_fd(ssl_, fd) != 1) {
+    BIO_free(stream_bio_);
+    throw std::runtime_error("SSL_set_fd failed.");
+  }
+}
+
+DirectSocketIo::~DirectSocketIo() {
+  Restore();
+}
+
+void DirectSocketIo::Restore() {
+  if (stream_bio_ != nullptr) {
+    // Same as ssl::stream does: one reference is taken over, the other one
+    // is added since the BIO is used for both directions.
+    SSL_set_bio(ssl_, stream_bio_, stream_bio_);
+    stream_bio_ = nullptr;
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+void EnableServerSessionCache(ssl::context& ssl_context, long size,
+                              long ttl_seconds) {
+  SSL_CTX* ssl_ctx = ssl_context.native_handle();
+
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(ssl_ctx, size);
+  SSL_CTX_set_timeout(ssl_ctx, ttl_seconds);
+
+  // Sessions are only resumed within the same context.
+  static const unsigned char kSessionIdContext[] = "boost-asio-study";
+  SSL_CTX_set_session_id_context(ssl_ctx, kSessionIdContext,
+                                 sizeof(kSessionIdContext) - 1);
+}
+
+void DisableSessionResumption(ssl::context& ssl_context) {
+  SSL_CTX* ssl_ctx = ssl_context.native_handle();
+
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_OFF);
+  SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_TICKET);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  // No TLS 1.3 tickets at all.
+  SSL_CTX_set_num_tickets(ssl_ctx, 0);
+#endif
+}
+
+SessionCacheStats GetSessionCacheStats(ssl::context& ssl_context) {
+  SSL_CTX* ssl_ctx = ssl_context.native_handle();
+
+  SessionCacheStats stats;
+  stats.hits = SSL_CTX_sess_hits(ssl_ctx);
+  stats.misses = SSL_CTX_sess_misses(ssl_ctx);
+  stats.timeouts = SSL_CTX_sess_timeouts(ssl_ctx);
+  stats.size = SSL_CTX_sess_number(ssl_ctx);
+  return stats;
+}
+
+// -----------------------------------------------------------------------------
+
+TicketKeyRing::TicketKeyRing(ssl::context& ssl_context,
+                             std::size_t keys_to_keep)
+    : ssl_context_(ssl_context),
+      keys_to_keep_(keys_to_keep > 0 ? keys_to_keep : 1),
+      hits_(0), renewals_(0), misses_(0) {
+  Rotate();
+
+  SSL_CTX* ssl_ctx = ssl_context_.native_handle();
+
+  SSL_CTX_clear_options(ssl_ctx, SSL_OP_NO_TICKET);
+  SSL_CTX_set_ex_data(ssl_ctx, TicketKeyRingIndex(), this);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_ctx, &TicketKeyCallback);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ssl_ctx, &TicketKeyCallback);
+#endif
+}
+
+TicketKeyRing::~TicketKeyRing() {
+  SSL_CTX* ssl_ctx = ssl_context_.native_handle();
+  SSL_CTX_set_ex_data(ssl_ctx, TicketKeyRingIndex(), nullptr);
+}
+
+void TicketKeyRing::Rotate() {
+  Key key;
+  if (RAND_bytes(key.name.data(), static_cast<int>(key.name.size())) != 1 ||
+      RAND_bytes(key.aes_key.data(),
+                 static_cast<int>(key.aes_key.size())) != 1 ||
+      RAND_bytes(key.hmac_key.data(),
+                 static_cast<int>(key.hmac_key.size())) != 1) {
+    throw std::runtime_error("Failed to generate a session ticket key.");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  keys_.push_front(key);
+  while (keys_.size() > keys_to_keep_) {
+    keys_.pop_back();
+  }
+}
+
+bool TicketKeyRing::CurrentKey(Key* key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (keys_.empty()) {
+    return false;
+  }
+  *key = keys_.front();
+  return true;
+}
+
+bool TicketKeyRing::FindKey(const unsigned char* name, Key* key,
+                            bool* is_current) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (std::size_t i = 0; i < keys_.size(); ++i) {
+    if (std::memcmp(keys_[i].name.data(), name, keys_[i].name.size()) == 0) {
+      *key = keys_[i];
+      *is_current = (i == 0);
+      return true;
+    }
+  }
+  return false;
+}
+
+void TicketKeyRing::CountHit(bool is_current) {
+  if (is_current) {
+    ++hits_;
+  } else {
+    ++renewals_;
+  }
+}
+
+void TicketKeyRing::CountMiss() {
+  ++misses_;
+}
+
+}  // namespace utility
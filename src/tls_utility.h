@@ -0,0 +1,165 @@
+#ifndef TLS_UTILITY_H_
+#define TLS_UTILITY_H_
+
+// TLS helpers on top of boost::asio::ssl::context (OpenSSL).
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/asio/ssl/context.hpp"
+
+namespace utility {
+
+// Protocol version, cipher suite and key exchange group profiles.
+//   - compat: the library defaults plus the finite field DH parameters
+//             (dh2048.pem), i.e., how |ssl_server| has always been set up.
+//   - ffdhe:  TLS 1.2 with finite field DHE key exchange only.
+//   - ecdhe:  TLS 1.2 and 1.3 (preferred), ECDHE over X25519/P-256 only,
+//             no FFDHE at all.
+//   - tls13:  TLS 1.3 only, X25519/P-256.
+// Throw std::invalid_argument for an unknown profile.
+void ApplyTlsProfile(boost::asio::ssl::context& ssl_context,
+                     const std::string& profile,
+                     const std::string& dh_file);
+
+// Names of all the profiles above.
+std::vector<std::string> GetTlsProfiles();
+
+// E.g., "TLSv1.3 TLS_AES_256_GCM_SHA384 X25519", or "No TLS connection" if
+// the handshake hasn't completed.
+std::string DescribeTlsConnection(SSL* ssl);
+
+// -----------------------------------------------------------------------------
+
+// ALPN (RFC 7301).
+
+// Encode the protocol names (e.g., "http/1.1") into the wire format, i.e.,
+// each name prefixed with its length.
+std::string EncodeAlpnProtocols(const std::vector<std::string>& protocols);
+
+// Client: offer the |encoded| protocols.
+bool SetAlpnProtocols(SSL* ssl, const std::string& encoded);
+
+// Server: select the first protocol of the client that is also in |encoded|,
+// in the order of the client. If there's none, ALPN is not used.
+// |encoded| must outlive the context.
+void SetAlpnSelection(boost::asio::ssl::context& ssl_context,
+                      const std::string* encoded);
+
+// The negotiated protocol, or empty.
+std::string GetAlpnProtocol(SSL* ssl);
+
+// -----------------------------------------------------------------------------
+
+// Let the SSL object of an ssl::stream do its I/O on the socket directly for
+// a while, then give it back to the stream.
+// ssl::stream runs OpenSSL over a BIO pair and moves the bytes between the
+// pair and the socket itself, but only for SSL_do_handshake(), SSL_read()
+// and SSL_write(). The TLS 1.3 early data (0-RTT) functions,
+// SSL_write_early_data() and SSL_read_early_data(), have to be run on the
+// socket instead (non-blocking; wait with the socket's async_wait()), before
+// the stream takes over for the rest of the handshake.
+// OpenSSL doesn't read ahead by default, so no byte for the stream is left
+// behind in the socket BIO.
+class DirectSocketIo {
+public:
+  DirectSocketIo(SSL* ssl, int fd);
+
+  // Restore() if not yet.
+  ~DirectSocketIo();
+
+  // Give the SSL object back to the stream.
+  void Restore();
+
+private:
+  SSL* ssl_;
+  BIO* stream_bio_;  // The stream's end of the BIO pair
+};
+
+// -----------------------------------------------------------------------------
+
+// Enable the server side session cache (session ID based resumption).
+// |size|: maximum number of sessions in the cache.
+// |ttl_seconds|: lifetime of a cached session, also of the session tickets.
+void EnableServerSessionCache(boost::asio::ssl::context& ssl_context,
+                              long size, long ttl_seconds);
+
+// Disable both the session cache and the session tickets.
+void DisableSessionResumption(boost::asio::ssl::context& ssl_context);
+
+// Hits and misses of the server side session cache.
+struct SessionCacheStats {
+  long hits = 0;
+  long misses = 0;
+  long timeouts = 0;
+  long size = 0;  // Number of sessions in the cache
+};
+
+SessionCacheStats GetSessionCacheStats(boost::asio::ssl::context& ssl_context);
+
+// -----------------------------------------------------------------------------
+
+// Keys for the stateless session tickets (RFC 5077), rotated in process.
+// The newest key encrypts new tickets; the older ones are kept for a while
+// to decrypt (and renew) the tickets issued with them.
+// Thread-safe; the ticket callback of OpenSSL could be called from any thread
+// doing a handshake.
+class TicketKeyRing {
+public:
+  // |keys_to_keep|: the current key plus the old keys still accepted.
+  TicketKeyRing(boost::asio::ssl::context& ssl_context,
+                std::size_t keys_to_keep = 2);
+
+  ~TicketKeyRing();
+
+  // Generate a new key for the new tickets.
+  // Call it periodically, e.g., with a steady_timer.
+  void Rotate();
+
+  // Tickets decrypted with the current key.
+  std::size_t hits() const { return hits_; }
+
+  // Tickets decrypted with an old key, and so reissued.
+  std::size_t renewals() const { return renewals_; }
+
+  // Tickets with an unknown (expired) key, leading to a full handshake.
+  std::size_t misses() const { return misses_; }
+
+  struct Key;
+
+  // Used by the OpenSSL ticket callback only.
+  // The key is copied out so that a concurrent Rotate() can't invalidate it.
+  bool CurrentKey(Key* key);
+  bool FindKey(const unsigned char* name, Key* key, bool* is_current);
+
+  void CountHit(bool is_current);
+  void CountMiss();
+
+private:
+  boost::asio::ssl::context& ssl_context_;
+
+  std::size_t keys_to_keep_;
+
+  std::mutex mutex_;
+  std::deque<Key> keys_;  // Newest first
+
+  std::atomic<std::size_t> hits_;
+  std::atomic<std::size_t> renewals_;
+  std::atomic<std::size_t> misses_;
+};
+
+struct TicketKeyRing::Key {
+  std::array<unsigned char, 16> name;
+  std::array<unsigned char, 32> aes_key;
+  std::array<unsigned char, 32> hmac_key;
+};
+
+}  // namespace utility
+
+#endif  // TLS_UTILITY_H_
@@ -1,8 +1,22 @@
 #include "utility.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <ostream>
 #include <sstream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using tcp = boost::asio::ip::tcp;
 
 namespace utility {
@@ -34,4 +48,224 @@ std::string EndpointToString(const boost::asio::ip::tcp::endpoint& endpoint) {
   return ss.str();
 }
 
+// -----------------------------------------------------------------------------
+
+namespace {
+
+#if defined(__linux__)
+std::size_t ReadStatm(const std::string& path) {
+  // The second field of statm is the resident set size in pages.
+  std::ifstream statm(path);
+  std::size_t size = 0;
+  std::size_t resident = 0;
+  if (statm >> size >> resident) {
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  }
+  return 0;
+}
+#endif  // defined(__linux__)
+
+}  // namespace
+
+std::size_t GetResidentMemory() {
+#if defined(__linux__)
+  return ReadStatm("/proc/self/statm");
+#else
+  return GetPeakResidentMemory();
+#endif  // defined(__linux__)
+}
+
+std::size_t GetResidentMemory(int pid) {
+#if defined(__linux__)
+  return ReadStatm("/proc/" + std::to_string(pid) + "/statm");
+#else
+  return 0;
+#endif  // defined(__linux__)
+}
+
+std::size_t GetPeakResidentMemory() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<std::size_t>(usage.ru_maxrss);  // Bytes
+#else
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;  // KB
+#endif  // defined(__APPLE__)
+#else
+  return 0;
+#endif
+}
+
+double GetCpuSeconds() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#else
+  return 0.0;
+#endif
+}
+
+std::size_t GetVoluntaryContextSwitches() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(usage.ru_nvcsw);
+#else
+  return 0;
+#endif
+}
+
+std::size_t RaiseOpenFileLimit() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return 0;
+  }
+  if (limit.rlim_cur < limit.rlim_max) {
+    struct rlimit raised = limit;
+    raised.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &raised) == 0) {
+      limit = raised;
+    }
+  }
+  return static_cast<std::size_t>(limit.rlim_cur);
+#else
+  return 0;
+#endif
+}
+
+std::vector<int> ParseCpuList(const std::string& list) {
+#if defined(__linux__)
+  const long kMaxCpu = CPU_SETSIZE - 1;
+#else
+  const long kMaxCpu = 1023;
+#endif  // defined(__linux__)
+
+  std::vector<int> cpus;
+  std::istringstream stream(list);
+  std::string part;
+  while (std::getline(stream, part, ',')) {
+    char* end = nullptr;
+    long first = std::strtol(part.c_str(), &end, 10);
+    if (end == part.c_str() || first < 0 || first > kMaxCpu) {
+      continue;
+    }
+    long last = first;
+    if (*end == '-') {
+      const char* begin = end + 1;
+      last = std::strtol(begin, &end, 10);
+      if (end == begin || last < first) {
+        continue;
+      }
+      // Not billions of numbers for a typo.
+      last = (std::min)(last, kMaxCpu);
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  return cpus;
+}
+
+bool SetThreadAffinity(const std::vector<int>& cpus) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (CPU_COUNT(&set) == 0) {
+    return false;
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif  // defined(__linux__)
+}
+
+int GetIncomingCpu(int fd) {
+#if defined(__linux__) && defined(SO_INCOMING_CPU)
+  int cpu = -1;
+  socklen_t size = sizeof(cpu);
+  if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &size) != 0) {
+    return -1;
+  }
+  return cpu;
+#else
+  return -1;
+#endif
+}
+
+bool SetBusyPoll(int fd, int us) {
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+  return setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) == 0;
+#else
+  return false;
+#endif
+}
+
+double Percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  std::size_t index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+// -----------------------------------------------------------------------------
+
+Options::Options(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      std::size_t pos = arg.find('=');
+      if (pos == std::string::npos) {
+        options_[arg.substr(2)] = "";
+      } else {
+        options_[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+      }
+    } else {
+      args_.push_back(arg);
+    }
+  }
+}
+
+bool Options::Has(const std::string& name) const {
+  return options_.find(name) != options_.end();
+}
+
+std::string Options::Get(const std::string& name,
+                         const std::string& default_value) const {
+  auto it = options_.find(name);
+  return it == options_.end() ? default_value : it->second;
+}
+
+long Options::GetInt(const std::string& name, long default_value) const {
+  auto it = options_.find(name);
+  if (it == options_.end() || it->second.empty()) {
+    return default_value;
+  }
+  return std::strtol(it->second.c_str(), nullptr, 10);
+}
+
+double Options::GetDouble(const std::string& name, double default_value) const {
+  auto it = options_.find(name);
+  if (it == options_.end() || it->second.empty()) {
+    return default_value;
+  }
+  return std::strtod(it->second.c_str(), nullptr);
+}
+
 }  // namespace utility
@@ -1,8 +1,11 @@
 #ifndef UTILITY_H_
 #define UTILITY_H_
 
+#include <cstddef>
 #include <iosfwd>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "boost/asio/ip/tcp.hpp"
 
@@ -17,6 +20,83 @@ void PrintEndpoints(
 
 std::string EndpointToString(const boost::asio::ip::tcp::endpoint& endpoint);
 
+// -----------------------------------------------------------------------------
+
+// Resident set size of the current process in bytes.
+// Returns 0 if it's not supported by the platform.
+std::size_t GetResidentMemory();
+
+// Resident set size of another process in bytes, e.g., of a server.
+// Linux only; returns 0 otherwise or if there's no such process.
+std::size_t GetResidentMemory(int pid);
+
+// Peak resident set size of the current process in bytes.
+std::size_t GetPeakResidentMemory();
+
+// User + system CPU time consumed by the current process, in seconds.
+double GetCpuSeconds();
+
+// Voluntary context switches of the current process (all threads), e.g., to
+// count how many times an event loop has gone to sleep and woken up.
+// Returns 0 if it's not supported by the platform.
+std::size_t GetVoluntaryContextSwitches();
+
+// Raise the soft limit of open files (RLIMIT_NOFILE) to the hard limit, e.g.,
+// for tens of thousands of connections. Returns the limit now in effect, or 0
+// if it's not supported by the platform.
+std::size_t RaiseOpenFileLimit();
+
+// Parse a CPU list like "0-3,8,10-11" (as in /sys/devices/system/cpu/online)
+// into CPU numbers. Invalid parts are ignored, and so are the CPUs beyond
+// what an affinity mask can hold (CPU_SETSIZE on Linux).
+std::vector<int> ParseCpuList(const std::string& list);
+
+// Pin the current thread to the |cpus|. Memory the thread touches first then
+// comes from the NUMA node of those CPUs (first-touch policy).
+// Linux only; returns false otherwise or on failure.
+bool SetThreadAffinity(const std::vector<int>& cpus);
+
+// The CPU which last processed the packets of a socket (SO_INCOMING_CPU).
+// Linux only; returns -1 otherwise or if unknown.
+int GetIncomingCpu(int fd);
+
+// Let the kernel busy-poll the device queue for up to |us| microseconds when a
+// read on the socket would block (SO_BUSY_POLL); raising it above the sysctl
+// net.core.busy_read needs CAP_NET_ADMIN. Loopback has no device queue to
+// poll. Linux only; returns false otherwise or on failure.
+bool SetBusyPoll(int fd, int us);
+
+// The value at |p| (0.0 ~ 1.0) of the |sorted| samples, e.g., 0.99 for p99.
+// Returns 0 if there's no sample.
+double Percentile(const std::vector<double>& sorted, double p);
+
+// -----------------------------------------------------------------------------
+
+// Simple command line parser.
+// Options are given as "--name=value" or "--name" (flag); everything else is
+// a positional argument.
+// E.g.,
+//   $ prog www.boost.org / --threads=4 --verbose
+class Options {
+public:
+  Options(int argc, char* argv[]);
+
+  const std::vector<std::string>& args() const { return args_; }
+
+  bool Has(const std::string& name) const;
+
+  std::string Get(const std::string& name,
+                  const std::string& default_value = "") const;
+
+  long GetInt(const std::string& name, long default_value) const;
+
+  double GetDouble(const std::string& name, double default_value) const;
+
+private:
+  std::vector<std::string> args_;
+  std::map<std::string, std::string> options_;
+};
+
 }  // namespace utility
 
 #endif  // UTILITY_H_
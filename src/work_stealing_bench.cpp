@@ -0,0 +1,310 @@
+// utility::WorkStealingPool vs boost::asio::thread_pool.
+// Workloads, each task spinning for --work iterations:
+//   - fan-out:   --tasks independent tasks posted from the main thread.
+//   - fork-join: a binary tree of tasks --depth deep, each inner task posting
+//                its two children from the pool; the last child to finish
+//                completes its parent.
+//   - offload:   handlers on a strand of an io_context offload a task to the
+//                pool with utility::Offload() and get the result back on the
+//                strand, --inflight at a time, --tasks in total.
+// E.g.,
+//   $ work_stealing_bench --threads=1,2,4 --tasks=200000 --depth=16 --work=1000
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/strand.hpp"
+#include "boost/asio/thread_pool.hpp"
+
+#include "utility.h"
+#include "work_stealing_pool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+// CPU work which the compiler can't skip.
+std::uint64_t Work(std::size_t iterations, std::uint64_t seed) {
+  std::uint64_t x = seed;
+  for (std::size_t i = 0; i < iterations; ++i) {
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  return x;
+}
+
+std::atomic<std::uint64_t> g_sink{ 0 };
+
+class Latch {
+public:
+  explicit Latch(std::size_t count) : count_(count) {
+  }
+
+  void CountDown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--count_ == 0) {
+      zero_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    zero_.wait(lock, [this]() { return count_ == 0; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable zero_;
+  std::size_t count_;
+};
+
+struct Options {
+  std::size_t tasks;
+  std::size_t depth;
+  std::size_t work;
+  std::size_t inflight;
+};
+
+// -----------------------------------------------------------------------------
+
+template <typename Executor>
+void FanOut(const Executor& executor, const Options& options) {
+  Latch latch(options.tasks);
+  for (std::size_t i = 0; i < options.tasks; ++i) {
+    boost::asio::post(executor, [&latch, &options, i]() {
+      g_sink.fetch_add(Work(options.work, i), std::memory_order_relaxed);
+      latch.CountDown();
+    });
+  }
+  latch.Wait();
+}
+
+template <typename Executor>
+class ForkJoin {
+public:
+  ForkJoin(const Executor& executor, const Options& options)
+      : executor_(executor), options_(options), latch_(1) {
+  }
+
+  void Run() {
+    Executor executor = executor_;
+    boost::asio::post(executor, [this]() { Fork(nullptr, options_.depth); });
+    latch_.Wait();
+  }
+
+private:
+  struct Node {
+    std::atomic<int> pending;
+    Node* parent;
+  };
+
+  void Fork(Node* parent, std::size_t depth) {
+    if (depth == 0) {
+      g_sink.fetch_add(Work(options_.work, depth), std::memory_order_relaxed);
+      Join(parent);
+      return;
+    }
+
+    Node* node = new Node{ { 2 }, parent };
+    for (int i = 0; i < 2; ++i) {
+      boost::asio::post(executor_, [this, node, depth]() {
+        Fork(node, depth - 1);
+      });
+    }
+  }
+
+  void Join(Node* node) {
+    while (node != nullptr) {
+      if (node->pending.fetch_sub(1) != 1) {
+        return;
+      }
+      Node* parent = node->parent;
+      delete node;
+      node = parent;
+    }
+    latch_.CountDown();
+  }
+
+  Executor executor_;
+  const Options& options_;
+  Latch latch_;
+};
+
+template <typename Executor>
+class Offloader {
+public:
+  Offloader(const Executor& pool, const Options& options)
+      : pool_(pool), options_(options), strand_(io_context_.get_executor()),
+        started_(0), completed_(0), off_strand_(0) {
+  }
+
+  // The completions not on the strand (should be 0).
+  std::size_t Run() {
+    for (std::size_t i = 0; i < options_.inflight; ++i) {
+      boost::asio::post(strand_, [this]() { Next(); });
+    }
+    io_context_.run();
+    return off_strand_;
+  }
+
+private:
+  void Next() {
+    if (started_ == options_.tasks) {
+      return;
+    }
+    std::size_t seed = started_++;
+
+    const Options& options = options_;
+    utility::Offload(pool_, strand_,
+                     [&options, seed]() { return Work(options.work, seed); },
+                     [this](std::uint64_t result) { OnResult(result); });
+  }
+
+  void OnResult(std::uint64_t result) {
+    if (!strand_.running_in_this_thread()) {
+      ++off_strand_;
+    }
+    g_sink.fetch_add(result, std::memory_order_relaxed);
+    ++completed_;
+    Next();
+  }
+
+  Executor pool_;
+  const Options& options_;
+
+  boost::asio::io_context io_context_;
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
+  std::size_t started_;
+  std::size_t completed_;
+  std::size_t off_strand_;
+};
+
+// -----------------------------------------------------------------------------
+
+void Print(const std::string& name, std::size_t tasks, Clock::duration elapsed,
+           const std::string& extra) {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << "    " << std::left << std::setw(18) << name << std::right
+            << std::fixed << std::setprecision(1) << std::setw(8)
+            << seconds * 1000 << " ms, " << std::setprecision(2)
+            << std::setw(6) << tasks / seconds / 1e6 << " M tasks/s" << extra
+            << std::endl;
+}
+
+// The steals are reported for |stealing| if not null.
+template <typename Pool>
+void RunAll(Pool& pool, const std::string& name, const Options& options,
+            const utility::WorkStealingPool* stealing) {
+  std::size_t fork_join_tasks = (std::size_t(2) << options.depth) - 1;
+
+  std::cout << "  " << name << std::endl;
+
+  auto steals = [stealing](std::size_t before) {
+    return stealing == nullptr ? std::string() :
+        ", steals: " + std::to_string(stealing->steals() - before);
+  };
+
+  std::size_t before = stealing != nullptr ? stealing->steals() : 0;
+  Clock::time_point start = Clock::now();
+  FanOut(pool.get_executor(), options);
+  Print("fan-out", options.tasks, Clock::now() - start, steals(before));
+
+  before = stealing != nullptr ? stealing->steals() : 0;
+  start = Clock::now();
+  ForkJoin<typename Pool::executor_type>(pool.get_executor(), options).Run();
+  Print("fork-join", fork_join_tasks, Clock::now() - start, steals(before));
+
+  start = Clock::now();
+  std::size_t off_strand =
+      Offloader<typename Pool::executor_type>(pool.get_executor(), options)
+          .Run();
+  Print("offload", options.tasks, Clock::now() - start,
+        ", off the strand: " + std::to_string(off_strand));
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::size_t> ParseList(const std::string& str) {
+  std::vector<std::size_t> list;
+  std::istringstream stream(str);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::size_t n = std::strtoul(item.c_str(), nullptr, 10);
+    if (n > 0) {
+      list.push_back(n);
+    }
+  }
+  return list;
+}
+
+void Help(const char* argv0) {
+  std::cout << "Usage: " << argv0 << " [options]" << std::endl;
+  std::cout << "  Options:" << std::endl;
+  std::cout << "    --threads=<n,...>   Default: 1,2,4" << std::endl;
+  std::cout << "    --tasks=<n>         Fan-out/offload tasks. Default: 200000"
+            << std::endl;
+  std::cout << "    --depth=<n>         Fork-join tree depth. Default: 16"
+            << std::endl;
+  std::cout << "    --work=<n>          Iterations per task. Default: 1000"
+            << std::endl;
+  std::cout << "    --inflight=<n>      Offloads at a time. Default: 16"
+            << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  utility::Options args(argc, argv);
+
+  if (args.Has("help")) {
+    Help(argv[0]);
+    return 0;
+  }
+
+  std::vector<std::size_t> threads_list =
+      ParseList(args.Get("threads", "1,2,4"));
+
+  Options options;
+  options.tasks = args.GetInt("tasks", 200000);
+  options.depth = args.GetInt("depth", 16);
+  options.work = args.GetInt("work", 1000);
+  options.inflight = args.GetInt("inflight", 16);
+
+  if (threads_list.empty() || options.tasks == 0 || options.depth > 24 ||
+      options.inflight == 0) {
+    Help(argv[0]);
+    return 1;
+  }
+
+  std::cout << "CPUs: " << std::thread::hardware_concurrency()
+            << ", work: " << options.work << " iterations per task"
+            << std::endl;
+
+  for (std::size_t threads : threads_list) {
+    std::cout << "threads: " << threads << std::endl;
+
+    {
+      utility::WorkStealingPool pool(threads);
+      RunAll(pool, "WorkStealingPool", options, &pool);
+      pool.Join();
+    }
+
+    {
+      boost::asio::thread_pool pool(threads);
+      RunAll(pool, "asio::thread_pool", options, nullptr);
+      pool.join();
+    }
+  }
+
+  return 0;
+}
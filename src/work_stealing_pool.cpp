@@ -0,0 +1,149 @@
+#include "work_stealing_pool.h"
+
+namespace utility {
+
+namespace {
+
+// The pool and the queue of the current thread, if it's a pool thread.
+thread_local const WorkStealingPool* t_pool = nullptr;
+thread_local std::size_t t_index = 0;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(std::size_t threads)
+    : next_(0), queued_(0), work_(1), joined_(false), stopped_(false),
+      idle_(0), steals_(0) {
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(new Worker);
+  }
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&WorkStealingPool::Loop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  Stop();
+  Join();
+
+  shutdown();
+  destroy();
+
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    for (Task* task : worker->tasks) {
+      delete task;
+    }
+  }
+}
+
+void WorkStealingPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  condition_.notify_all();
+}
+
+void WorkStealingPool::Join() {
+  if (!joined_) {
+    joined_ = true;
+    WorkFinished();
+  }
+
+  for (std::thread& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+bool WorkStealingPool::RunningInThisThread() const {
+  return t_pool == this;
+}
+
+void WorkStealingPool::Post(Task* task) {
+  work_.fetch_add(1);
+
+  std::size_t index = RunningInThisThread()
+      ? t_index
+      : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  // Counted before queued, so that an idle thread checking |queued_| after
+  // |idle_| has been read here won't miss it.
+  queued_.fetch_add(1);
+  {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(task);
+  }
+
+  if (idle_.load() > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_.notify_one();
+  }
+}
+
+void WorkStealingPool::WorkFinished() {
+  if (work_.fetch_sub(1) == 1) {
+    Stop();
+  }
+}
+
+void WorkStealingPool::Loop(std::size_t index) {
+  t_pool = this;
+  t_index = index;
+
+  while (!stopped_.load(std::memory_order_relaxed)) {
+    Task* task = Pop(index);
+    if (task == nullptr) {
+      task = Steal(index);
+    }
+
+    if (task != nullptr) {
+      queued_.fetch_sub(1);
+      task->Run();
+      WorkFinished();
+      continue;
+    }
+
+    // A task counted but not queued yet is picked up on the next round.
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.fetch_add(1);
+    condition_.wait(lock, [this]() {
+      return stopped_ || queued_.load() > 0;
+    });
+    idle_.fetch_sub(1);
+  }
+
+  t_pool = nullptr;
+}
+
+WorkStealingPool::Task* WorkStealingPool::Pop(std::size_t index) {
+  Worker& worker = *workers_[index];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.tasks.empty()) {
+    return nullptr;
+  }
+  Task* task = worker.tasks.back();
+  worker.tasks.pop_back();
+  return task;
+}
+
+WorkStealingPool::Task* WorkStealingPool::Steal(std::size_t index) {
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    Worker& worker = *workers_[(index + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      Task* task = worker.tasks.front();
+      worker.tasks.pop_front();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace utility
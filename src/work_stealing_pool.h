@@ -0,0 +1,270 @@
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+// A thread pool for CPU work, so that heavy handlers don't hold up the
+// io_context threads (and all the sockets served by them).
+// Each thread has its own queue of tasks: a task posted from a pool thread
+// goes to the back of the queue of that thread, which runs its tasks from the
+// back (the most recent first); an idle thread steals from the front of the
+// queue of another thread. Tasks posted from outside are spread round-robin.
+// WorkStealingPool::executor_type is an Asio executor, used like the executor
+// of boost::asio::thread_pool:
+//   utility::WorkStealingPool pool{ 4 };
+//   boost::asio::post(pool.get_executor(), []() { ... });
+//   pool.Join();
+// To run some work on the pool and get its result back on the strand (or
+// io_context) of the calling handler, see Offload().
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/associated_executor.hpp"
+#include "boost/asio/dispatch.hpp"
+#include "boost/asio/execution_context.hpp"
+#include "boost/asio/executor_work_guard.hpp"
+#include "boost/asio/post.hpp"
+
+namespace utility {
+
+class WorkStealingPool : public boost::asio::execution_context {
+public:
+  class executor_type;
+
+  // Start |threads| threads (at least one).
+  explicit WorkStealingPool(std::size_t threads);
+
+  // Stop the threads and destroy the tasks not run yet.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  executor_type get_executor() noexcept;
+
+  // Stop the threads as soon as possible, leaving the tasks not run yet.
+  void Stop();
+
+  // Wait for the threads to run out of work, i.e., no task left and no
+  // outstanding work (see executor_work_guard), and exit.
+  // Must not be called from a pool thread.
+  void Join();
+
+  // The tasks run by a thread other than the one they were queued to.
+  std::size_t steals() const { return steals_; }
+
+private:
+  struct Task {
+    virtual ~Task() {}
+
+    // Run and delete the task.
+    virtual void Run() = 0;
+  };
+
+  template <typename Function>
+  struct TaskImpl : Task {
+    explicit TaskImpl(Function&& f) : function(std::move(f)) {
+    }
+
+    void Run() override {
+      // Free the task before the upcall, which may post again.
+      Function f(std::move(function));
+      delete this;
+      f();
+    }
+
+    Function function;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task*> tasks;
+  };
+
+  bool RunningInThisThread() const;
+
+  void Post(Task* task);
+
+  void WorkStarted() { work_.fetch_add(1); }
+
+  void WorkFinished();
+
+  void Loop(std::size_t index);
+
+  // From the back of the own queue.
+  Task* Pop(std::size_t index);
+
+  // From the front of the queues of the others.
+  Task* Steal(std::size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+
+  // Round-robin over the queues for the tasks posted from outside.
+  std::atomic<std::size_t> next_;
+
+  // The tasks queued, and the tasks plus the outstanding work. The pool has
+  // one unit of work itself until Join() is called.
+  std::atomic<std::size_t> queued_;
+  std::atomic<std::size_t> work_;
+  bool joined_;
+
+  std::atomic<bool> stopped_;
+
+  // For the idle threads to wait for tasks.
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::atomic<std::size_t> idle_;
+
+  std::atomic<std::size_t> steals_;
+};
+
+// The executor of the pool, see the Executor requirements of Asio.
+class WorkStealingPool::executor_type {
+public:
+  WorkStealingPool& context() const noexcept { return *pool_; }
+
+  void on_work_started() const noexcept { pool_->WorkStarted(); }
+
+  void on_work_finished() const noexcept { pool_->WorkFinished(); }
+
+  // Run the function right away if called from a pool thread.
+  template <typename Function, typename Allocator>
+  void dispatch(Function&& f, const Allocator& a) const {
+    if (running_in_this_thread()) {
+      typename std::decay<Function>::type function(std::forward<Function>(f));
+      function();
+      return;
+    }
+    post(std::forward<Function>(f), a);
+  }
+
+  template <typename Function, typename Allocator>
+  void post(Function&& f, const Allocator&) const {
+    typedef typename std::decay<Function>::type function_type;
+    pool_->Post(new TaskImpl<function_type>(std::forward<Function>(f)));
+  }
+
+  template <typename Function, typename Allocator>
+  void defer(Function&& f, const Allocator& a) const {
+    post(std::forward<Function>(f), a);
+  }
+
+  bool running_in_this_thread() const noexcept {
+    return pool_->RunningInThisThread();
+  }
+
+  friend bool operator==(const executor_type& a,
+                         const executor_type& b) noexcept {
+    return a.pool_ == b.pool_;
+  }
+
+  friend bool operator!=(const executor_type& a,
+                         const executor_type& b) noexcept {
+    return a.pool_ != b.pool_;
+  }
+
+private:
+  friend class WorkStealingPool;
+
+  explicit executor_type(WorkStealingPool& pool) : pool_(&pool) {
+  }
+
+  WorkStealingPool* pool_;
+};
+
+inline WorkStealingPool::executor_type
+WorkStealingPool::get_executor() noexcept {
+  return executor_type(*this);
+}
+
+// -----------------------------------------------------------------------------
+
+namespace detail {
+
+// Runs the function on the pool, then dispatches the handler with the result
+// to its executor.
+template <typename Function, typename Handler, typename Executor>
+class OffloadOp {
+public:
+  typedef typename std::result_of<Function()>::type result_type;
+
+  OffloadOp(Function&& function, Handler&& handler, const Executor& executor)
+      : function_(std::move(function)), handler_(std::move(handler)),
+        work_(executor) {
+  }
+
+  void operator()() {
+    Complete(std::is_void<result_type>());
+  }
+
+private:
+  // Binds the result so that the handler could be dispatched.
+  struct Binder {
+    void operator()() { handler(std::move(result)); }
+
+    Handler handler;
+    result_type result;
+  };
+
+  void Complete(std::false_type) {
+    Binder binder{ std::move(handler_), function_() };
+    boost::asio::dispatch(work_.get_executor(), std::move(binder));
+    work_.reset();
+  }
+
+  void Complete(std::true_type) {
+    function_();
+    boost::asio::dispatch(work_.get_executor(), std::move(handler_));
+    work_.reset();
+  }
+
+  Function function_;
+  Handler handler_;
+
+  // Keeps the io_context of the handler from running out of work.
+  boost::asio::executor_work_guard<Executor> work_;
+};
+
+}  // namespace detail
+
+// Run |function| on a thread pool (the executor |pool|, e.g., of a
+// WorkStealingPool or a boost::asio::thread_pool), then |handler| with its
+// result (or with no argument if it returns void) on the associated executor
+// of the handler, |executor| by default. E.g., in a handler on a strand:
+//   utility::Offload(pool.get_executor(), strand_,
+//                    std::bind(&Compress, data_),
+//                    std::bind(&Session::OnCompressed, this,
+//                              std::placeholders::_1));
+// The executor has outstanding work meanwhile, so io_context::run() doesn't
+// return. The function must not throw.
+template <typename PoolExecutor, typename Executor, typename Function,
+          typename Handler>
+void Offload(const PoolExecutor& pool, const Executor& executor,
+             Function&& function, Handler&& handler) {
+  typedef typename std::decay<Function>::type function_type;
+  typedef typename std::decay<Handler>::type handler_type;
+  typedef typename boost::asio::associated_executor<
+      handler_type, Executor>::type executor_type;
+
+  handler_type h(std::forward<Handler>(handler));
+  executor_type handler_executor =
+      boost::asio::get_associated_executor(h, executor);
+
+  boost::asio::post(
+      pool,
+      detail::OffloadOp<function_type, handler_type, executor_type>(
+          function_type(std::forward<Function>(function)), std::move(h),
+          handler_executor));
+}
+
+}  // namespace utility
+
+#endif  // WORK_STEALING_POOL_H_